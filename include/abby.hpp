@@ -33,24 +33,42 @@
 
 #include <algorithm>        // min, max, clamp
 #include <array>            // array
+#include <atomic>           // atomic, memory_order_acq_rel
 #include <cassert>          // assert
+#include <chrono>           // steady_clock, nanoseconds
 #include <cmath>            // abs
-#include <cstddef>          // byte
+#include <cstddef>          // byte, ptrdiff_t
+#include <cstdint>          // uint32_t, uint64_t
 #include <deque>            // deque
+#include <functional>       // greater
+#include <future>           // future, async
+#include <iterator>         // back_inserter, forward_iterator_tag
 #include <limits>           // numeric_limits
+#include <memory>           // unique_ptr, make_unique
 #include <memory_resource>  // monotonic_buffer_resource
 #include <optional>         // optional
 #include <ostream>          // ostream
+#include <queue>            // priority_queue
 #include <stack>            // stack
 #include <stdexcept>        // invalid_argument
 #include <string>           // string
+#include <thread>           // thread
+#include <type_traits>      // is_arithmetic_v
 #include <unordered_map>    // unordered_map
+#include <unordered_set>    // unordered_set
+#include <utility>          // pair
 #include <vector>           // vector
 
 namespace abby {
 
 using maybe_index = std::optional<std::size_t>;
 
+/// A set of collision categories, e.g. "player", "enemy" or "projectile".
+using category_mask = std::uint32_t;
+
+/// A category mask that matches all collision categories.
+inline constexpr category_mask all_categories = ~category_mask{0};
+
 /**
  * \struct vector2
  *
@@ -468,6 +486,209 @@ template <typename T>
   return !(lhs == rhs);
 }
 
+/**
+ * \enum rebuild_strategy
+ *
+ * \brief Provides identifiers for the algorithms that can be used to rebuild a
+ * tree.
+ *
+ * \since 0.3.0
+ */
+enum class rebuild_strategy
+{
+  greedy,      ///< Greedy agglomeration of the cheapest pair, O(n^3).
+  binned_sah,  ///< Top-down binned surface area heuristic, O(n log n).
+  lbvh,        ///< Linear BVH emitted from sorted Morton codes, O(n).
+  ploc         ///< Parallel locally-ordered clustering of Morton-sorted nodes.
+};
+
+/**
+ * \enum balancing_strategy
+ *
+ * \brief Provides identifiers for the ways a tree can restructure itself after
+ * insertions and removals.
+ *
+ * \since 0.3.0
+ */
+enum class balancing_strategy
+{
+  height,        ///< AVL-style rotations that keep the heights balanced.
+  surface_area,  ///< Rotations that minimize the total surface area (Kensler).
+  none           ///< No rotations, preserves the structure of a rebuilt tree.
+};
+
+/**
+ * \enum insertion_strategy
+ *
+ * \brief Provides identifiers for the algorithms used to find the sibling of a
+ * new leaf.
+ *
+ * \since 0.3.0
+ */
+enum class insertion_strategy
+{
+  greedy,           ///< Descends towards the cheapest child, O(log n).
+  branch_and_bound  ///< Finds the optimal sibling, explores more of the tree.
+};
+
+/**
+ * \struct rebuild_policy
+ *
+ * \brief Describes when and how a tree automatically restores its quality.
+ *
+ * \details The quality of a tree is measured by its surface area ratio, i.e.
+ * the total area of all nodes divided by the area of the root. Maintenance is
+ * scheduled when the ratio exceeds the ratio after the last rebuild by the
+ * specified factor, and performed by `tree::maintain()`.
+ *
+ * \since 0.3.0
+ */
+struct rebuild_policy final
+{
+  /// The relative degradation of the surface area ratio that is tolerated.
+  double threshold{1.5};
+
+  /// The strategy used when the tree is rebuilt.
+  rebuild_strategy strategy{rebuild_strategy::binned_sah};
+
+  /// The budget of an optimization pass that is attempted before rebuilding,
+  /// zero disables the optimization pass.
+  std::size_t optimizeBudget{0};
+
+  /// Trees with fewer entries than this are never maintained.
+  std::size_t minSize{64};
+};
+
+/**
+ * \struct rebuild_stats
+ *
+ * \brief Provides information about the automatic maintenance of a tree.
+ *
+ * \details The amortized cost of the maintenance per operation is the total
+ * time divided by the amount of checks.
+ *
+ * \since 0.3.0
+ */
+struct rebuild_stats final
+{
+  std::size_t checks{};         ///< Amount of quality checks.
+  std::size_t optimizations{};  ///< Amount of optimization passes.
+  std::size_t rebuilds{};       ///< Amount of automatic rebuilds.
+  std::chrono::nanoseconds time{};  ///< Total time spent on maintenance.
+  double baselineRatio{};  ///< The surface area ratio after the last rebuild.
+};
+
+/**
+ * \struct no_aggregate
+ *
+ * \brief The default subtree aggregate, which doesn't aggregate anything.
+ *
+ * \details An aggregate is a monoid, i.e. a type that provides a `value_type`,
+ * an `identity()` value and an associative and commutative `combine()`
+ * function. Each node stores the combined value of all leaves in its subtree.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+struct no_aggregate final
+{
+  struct value_type final
+  {};
+
+  [[nodiscard]] static constexpr auto identity() noexcept -> value_type
+  {
+    return {};
+  }
+
+  [[nodiscard]] static constexpr auto combine(const value_type&,
+                                              const value_type&) noexcept
+      -> value_type
+  {
+    return {};
+  }
+};
+
+/**
+ * \struct sum_aggregate
+ *
+ * \brief A subtree aggregate that sums the values of the leaves, e.g. mass or
+ * threat.
+ *
+ * \tparam T the type of the summed values.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+template <typename T>
+struct sum_aggregate final
+{
+  using value_type = T;
+
+  [[nodiscard]] static constexpr auto identity() noexcept -> value_type
+  {
+    return value_type{};
+  }
+
+  [[nodiscard]] static constexpr auto combine(const value_type& lhs,
+                                              const value_type& rhs)
+      -> value_type
+  {
+    return lhs + rhs;
+  }
+};
+
+/**
+ * \struct perimeter_metric
+ *
+ * \brief The default cost metric, which uses the perimeter of the AABBs.
+ *
+ * \details A cost metric provides a static `cost()` function that estimates
+ * how expensive it is to visit a node with the specified AABB during a query.
+ * The metric drives all structural decisions of a tree, i.e. insertions,
+ * rebuilds and restructuring. User-defined metrics must not decrease when an
+ * AABB grows. The perimeter is the 2D analogue of the surface area heuristic
+ * and is also meaningful for degenerate AABBs.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+struct perimeter_metric final
+{
+  template <typename T>
+  [[nodiscard]] static constexpr auto cost(const aabb<T>& aabb) noexcept
+      -> double
+  {
+    return aabb.area();
+  }
+};
+
+/**
+ * \struct area_metric
+ *
+ * \brief A cost metric that uses the true area of the AABBs, i.e. the width
+ * times the height.
+ *
+ * \details This penalizes elongated nodes less than the perimeter, which tends
+ * to produce better trees for long and thin AABBs, e.g. corridors.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+struct area_metric final
+{
+  template <typename T>
+  [[nodiscard]] static constexpr auto cost(const aabb<T>& aabb) noexcept
+      -> double
+  {
+    const auto size = aabb.size();
+    return static_cast<double>(size.x) * static_cast<double>(size.y);
+  }
+};
+
 /**
  * \struct node
  *
@@ -478,16 +699,18 @@ template <typename T>
  *
  * \tparam Key the type of the keys associated with each node.
  * \tparam T the representation type used by the AABBs.
+ * \tparam Aggregate the type of the subtree aggregate.
  *
  * \since 0.1.0
  *
  * \headerfile abby.hpp
  */
-template <typename Key, typename T>
+template <typename Key, typename T, typename Aggregate = no_aggregate>
 struct node final
 {
   using key_type = Key;
   using aabb_type = aabb<T>;
+  using aggregate_value = typename Aggregate::value_type;
 
   std::optional<key_type> id;
   aabb_type aabb;
@@ -498,12 +721,24 @@ struct node final
   maybe_index next;
   int height{-1};
 
+  /// The categories of a leaf, or the union of the categories in a subtree.
+  category_mask categories{all_categories};
+
+  /// The amount of leaves in the subtree.
+  std::size_t count{1};
+
+  /// The value of a leaf, or the combined value of the leaves in a subtree.
+  aggregate_value value{Aggregate::identity()};
+
   [[nodiscard]] auto is_leaf() const noexcept -> bool
   {
     return left == std::nullopt;
   }
 };
 
+template <typename Key, typename T>
+class async_tree;
+
 /**
  * \class tree
  *
@@ -513,12 +748,19 @@ struct node final
  * comparable and preferably small and cheap to copy type, e.g. `int`.
  * \tparam T the representation type used by the AABBs, should be a
  * floating-point type for best precision.
+ * \tparam Aggregate the type of the subtree aggregate, see `no_aggregate` and
+ * `sum_aggregate`.
+ * \tparam CostMetric the metric used to estimate the cost of nodes, see
+ * `perimeter_metric` and `area_metric`.
  *
  * \since 0.1.0
  *
  * \headerfile abby.hpp
  */
-template <typename Key, typename T = double>
+template <typename Key,
+          typename T = double,
+          typename Aggregate = no_aggregate,
+          typename CostMetric = perimeter_metric>
 class tree final
 {
   template <typename U>
@@ -529,10 +771,171 @@ class tree final
   using key_type = Key;
   using vector_type = vector2<value_type>;
   using aabb_type = aabb<value_type>;
-  using node_type = node<key_type, value_type>;
+  using aggregate_type = Aggregate;
+  using aggregate_value = typename aggregate_type::value_type;
+  using cost_metric = CostMetric;
+  using node_type = node<key_type, value_type, aggregate_type>;
   using size_type = std::size_t;
   using index_type = size_type;
 
+  /**
+   * \class query_iterator
+   *
+   * \brief A forward iterator over the collision candidates of an AABB.
+   *
+   * \details The underlying traversal is advanced on demand, one candidate at
+   * a time, and doesn't allocate any memory.
+   *
+   * \note Iterators are invalidated by any modification of the tree.
+   *
+   * \since 0.3.0
+   *
+   * \headerfile abby.hpp
+   */
+  class query_iterator final
+  {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = key_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const key_type*;
+    using reference = const key_type&;
+
+    /**
+     * \brief Creates a past-the-end iterator.
+     *
+     * \since 0.3.0
+     */
+    query_iterator() noexcept = default;
+
+    query_iterator(const tree* tree,
+                   const index_type source,
+                   const category_mask mask)
+        : m_tree{tree},
+          m_source{source},
+          m_mask{mask},
+          m_current{tree->m_root}
+    {
+      advance();
+    }
+
+    auto operator++() -> query_iterator&
+    {
+      advance();
+      return *this;
+    }
+
+    auto operator++(int) -> query_iterator
+    {
+      auto copy = *this;
+      advance();
+      return copy;
+    }
+
+    [[nodiscard]] auto operator*() const -> reference
+    {
+      return m_tree->m_nodes.at(m_leaf.value()).id.value();
+    }
+
+    [[nodiscard]] auto operator->() const -> pointer
+    {
+      return &**this;
+    }
+
+    [[nodiscard]] auto operator==(const query_iterator& other) const noexcept
+        -> bool
+    {
+      return m_leaf == other.m_leaf;
+    }
+
+    [[nodiscard]] auto operator!=(const query_iterator& other) const noexcept
+        -> bool
+    {
+      return !(*this == other);
+    }
+
+   private:
+    const tree* m_tree{};
+    index_type m_source{};
+    category_mask m_mask{all_categories};
+    maybe_index m_current;
+    maybe_index m_previous;
+    maybe_index m_leaf;
+
+    void advance()
+    {
+      const auto& sourceAabb = m_tree->m_nodes.at(m_source).aabb;
+      do {
+        m_leaf = m_tree->next_overlapping_leaf(sourceAabb,
+                                               m_current,
+                                               m_previous,
+                                               m_mask);
+      } while (m_leaf == m_source);  // Can't interact with itself
+    }
+  };
+
+  /**
+   * \struct nearest_entry
+   *
+   * \brief The result of a closest-entry query.
+   *
+   * \since 0.3.0
+   *
+   * \headerfile abby.hpp
+   */
+  struct nearest_entry final
+  {
+    key_type key;            ///< The ID of the closest AABB.
+    double distanceSquared;  ///< The squared distance to the closest AABB.
+  };
+
+  /**
+   * \class query_view
+   *
+   * \brief A lazily evaluated range of collision candidates.
+   *
+   * \see `tree::query_range()`
+   *
+   * \since 0.3.0
+   *
+   * \headerfile abby.hpp
+   */
+  class query_view final
+  {
+   public:
+    using iterator = query_iterator;
+    using const_iterator = query_iterator;
+
+    query_view() noexcept = default;
+
+    query_view(const tree* tree,
+               const index_type source,
+               const category_mask mask) noexcept
+        : m_tree{tree},
+          m_source{source},
+          m_mask{mask}
+    {}
+
+    [[nodiscard]] auto begin() const -> iterator
+    {
+      if (m_source) {
+        return iterator{m_tree, *m_source, m_mask};
+      } else {
+        return end();
+      }
+    }
+
+    [[nodiscard]] auto end() const noexcept -> iterator
+    {
+      return iterator{};
+    }
+
+   private:
+    const tree* m_tree{};
+    maybe_index m_source;
+    category_mask m_mask{all_categories};
+  };
+
   /**
    * \brief Creates an AABB tree.
    *
@@ -559,32 +962,80 @@ class tree final
    * \param key the ID that will be associated with the box.
    * \param lowerBound the lower-bound position of the AABB (i.e. the position).
    * \param upperBound the upper-bound position of the AABB.
+   * \param categories the collision categories of the AABB, used to filter
+   * queries.
+   * \param value the aggregate value associated with the AABB.
    *
    * \since 0.1.0
    */
   void insert(const key_type& key,
               const vector_type& lowerBound,
-              const vector_type& upperBound)
+              const vector_type& upperBound,
+              const category_mask categories = all_categories,
+              const aggregate_value& value = aggregate_type::identity())
   {
-    // Make sure the particle doesn't already exist
-    assert(!m_indexMap.count(key));
+    const auto nodeIndex =
+        allocate_leaf(key, {lowerBound, upperBound}, categories, value);
+    insert_leaf(nodeIndex);
 
-    // Allocate a new node for the particle
-    const auto nodeIndex = allocate_node();
-    auto& node = m_nodes.at(nodeIndex);
-    node.id = key;
-    node.aabb = {lowerBound, upperBound};
-    node.aabb.fatten(m_skinThickness);
-    node.height = 0;
-    // node.aabb.m_area = node.aabb.compute_area();
-    // m_nodes[node].aabb.m_centre = m_nodes[node].aabb.computeCentre();
+#ifndef NDEBUG
+    validate();
+#endif
 
-    insert_leaf(nodeIndex);
-    m_indexMap.emplace(key, nodeIndex);
+    check_quality();
+  }
+
+  /**
+   * \brief Inserts a batch of AABBs in the tree.
+   *
+   * \details The new entries are built into a separate subtree, which is then
+   * inserted into the tree as a single node. If the batch is at least as
+   * large as the current tree, the entire tree is rebuilt instead. Either way,
+   * the tree is only restructured once, instead of once per entry.
+   *
+   * A spliced subtree that overlaps much of the tree can make queries slower
+   * than inserting the entries one by one, so prefer this for batches that
+   * are spatially coherent, or rebuild the tree afterwards.
+   *
+   * \pre The keys in the range must be unique and cannot already be in use.
+   *
+   * \tparam InputIt the type of the input iterators, the value type must be a
+   * tuple-like type of a key, a lower bound and an upper bound, e.g.
+   * `std::tuple<key_type, vector_type, vector_type>`.
+   *
+   * \param first the first element of the range.
+   * \param last the element one past the last element of the range.
+   *
+   * \since 0.3.0
+   */
+  template <typename InputIt>
+  void insert_range(InputIt first, InputIt last)
+  {
+    const auto oldSize = size();
+
+    std::vector<index_type> leaves;
+    for (; first != last; ++first) {
+      const auto& [key, lowerBound, upperBound] = *first;
+      leaves.push_back(allocate_leaf(key, {lowerBound, upperBound}));
+    }
+
+    if (leaves.empty()) {
+      return;
+    }
+
+    if (leaves.size() >= oldSize) {
+      leaves = release_internal_nodes();
+      m_root = build_binned_sah(leaves);
+      on_rebuilt();
+    } else {
+      insert_leaf(build_binned_sah(leaves));
+    }
 
 #ifndef NDEBUG
     validate();
 #endif
+
+    check_quality();
   }
 
   /**
@@ -613,6 +1064,8 @@ class tree final
 #ifndef NDEBUG
       validate();
 #endif
+
+      check_quality();
     }
   }
 
@@ -642,6 +1095,8 @@ class tree final
 
     // Clear the particle map.
     m_indexMap.clear();
+    m_totalArea = 0;
+    m_isMaintenancePending = false;
 
 #ifndef NDEBUG
     validate();
@@ -696,10 +1151,7 @@ class tree final
       remove_leaf(nodeIndex);
       aabb.fatten(m_skinThickness);
 
-      auto& node = m_nodes.at(nodeIndex);
-      node.aabb = aabb;
-      node.aabb.update_area();
-      // node.aabb.m_area = aabb.compute_area();
+      set_aabb(m_nodes.at(nodeIndex), aabb);
       // m_nodes[node].aabb.m_centre = m_nodes[node].aabb.computeCentre();
 
       insert_leaf(nodeIndex);
@@ -707,6 +1159,8 @@ class tree final
 #ifndef NDEBUG
       validate();
 #endif
+
+      check_quality();
       return true;
     } else {
       return false;
@@ -722,78 +1176,331 @@ class tree final
   }
 
   /**
-   * \brief Updates the position of the AABB associated with the specified ID.
+   * \brief Updates the AABBs of a batch of entries without changing the
+   * structure of the tree.
    *
-   * \note This function has no effect if there is no AABB associated with the
-   * specified ID.
+   * \details The new AABBs are written to the leaves, after which the AABBs of
+   * the affected internal nodes are recomputed bottom-up in a single pass.
+   * Subtrees without changed leaves are never visited, and as with `update()`,
+   * leaves whose new AABB is within their fattened AABB are left unchanged.
+   * Since the structure is kept, the quality of the tree degrades as entries
+   * move apart, so the surface area ratio is returned to let callers decide
+   * when to restructure the tree, e.g. with `optimize()` or `rebuild()`.
    *
-   * \param key the ID associated with the AABB that will be moved.
-   * \param position the new position of the AABB associated with the specified
-   * ID.
-   * \param forceReinsert `true` if the associated AABB is forced to be
-   * reinserted into the tree.
+   * \note Keys that aren't associated with an AABB are ignored.
    *
-   * \return `true` if an AABB was updated; `false` otherwise.
+   * \tparam InputIt the type of the input iterators, the value type must be a
+   * pair-like type of a key and an AABB, e.g. `std::pair<key_type, aabb_type>`.
    *
-   * \since 0.1.0
+   * \param first the first element of the range.
+   * \param last the element one past the last element of the range.
+   *
+   * \return the surface area ratio of the tree after the refit.
+   *
+   * \since 0.3.0
    */
-  auto relocate(const key_type& key,
-                const vector_type& position,
-                bool forceReinsert = false) -> bool
+  template <typename InputIt>
+  auto refit(InputIt first, InputIt last) -> double
   {
-    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
-      const auto& aabb = m_nodes.at(it->second).aabb;
-      return update(key, {position, position + aabb.size()}, forceReinsert);
-    } else {
-      return false;
-    }
-  }
+    std::vector<bool> isMarked(m_nodeCapacity, false);
+    bool anyMarked{false};
 
-  /// Rebuild an optimal tree.
-  void rebuild()
-  {
-    std::vector<index_type> nodeIndices(m_nodeCount);
-    int count{0};
+    for (; first != last; ++first) {
+      const auto& [key, aabb] = *first;
 
-    for (auto index = 0; index < m_nodeCapacity; ++index) {
-      if (m_nodes.at(index).height < 0) {  // Free node.
+      const auto it = m_indexMap.find(key);
+      if (it == m_indexMap.end()) {
         continue;
       }
 
-      if (m_nodes.at(index).is_leaf()) {
-        m_nodes.at(index).parent = std::nullopt;
-        nodeIndices.at(count) = index;
-        ++count;
-      } else {
-        free_node(index);
+      auto& node = m_nodes.at(it->second);
+      if (node.aabb.contains(aabb)) {
+        continue;
+      }
+
+      aabb_type fattened{aabb};
+      fattened.fatten(m_skinThickness);
+      set_aabb(node, fattened);
+
+      // Stop at the first ancestor that was marked by a previous leaf.
+      for (auto parent = node.parent; parent && !isMarked[*parent];
+           parent = m_nodes.at(*parent).parent) {
+        isMarked[*parent] = true;
+        anyMarked = true;
       }
     }
 
-    while (count > 1) {
-      auto minCost = std::numeric_limits<double>::max();
-      int iMin{-1};
-      int jMin{-1};
+    if (anyMarked) {
+      refit_marked(isMarked);
+    }
 
-      for (auto i = 0; i < count; ++i) {
-        const auto fstAabb = m_nodes.at(nodeIndices.at(i)).aabb;
+#ifndef NDEBUG
+    validate();
+#endif
 
-        for (auto j = (i + 1); j < count; ++j) {
-          const auto sndAabb = m_nodes.at(nodeIndices.at(j)).aabb;
-          const auto cost = aabb_type::merge(fstAabb, sndAabb).area();
+    check_quality();
 
-          if (cost < minCost) {
-            iMin = i;
-            jMin = j;
-            minCost = cost;
-          }
+    return compute_surface_area_ratio();
+  }
+
+  /**
+   * \brief Updates the AABBs of a batch of entries.
+   *
+   * \details As with `update()`, entries whose new AABB is within their
+   * fattened AABB are left unchanged, and the other entries are reinserted.
+   * However, only the AABBs of the ancestors are kept up-to-date during the
+   * reinsertions, and only as far up as they change. The heights and
+   * augmentations of the affected internal nodes are recomputed in a single
+   * pass afterwards, so that each node is only refitted once.
+   *
+   * No rotations are performed during the reinsertions. Instead, the final
+   * pass restructures each affected node once. This is intended for the
+   * `surface_area` balancing strategy, where it saves most of the rotations
+   * of `update()`. With the `none` strategy, it performs about as well as
+   * `update()`. The height balance can't be restored by a single pass, so
+   * trees that use the `height` strategy update the entries one by one with
+   * `update()` instead.
+   *
+   * \note Keys that aren't associated with an AABB are ignored. If a key occurs
+   * several times, the last AABB is used.
+   *
+   * \tparam KeyIt the type of the key iterators.
+   * \tparam AabbIt the type of the AABB iterator, the value type must be
+   * `aabb_type`.
+   *
+   * \param firstKey the first key of the batch.
+   * \param lastKey the key one past the last key of the batch.
+   * \param firstAabb the new AABB of the first key, followed by the AABBs of
+   * the other keys in the same order.
+   *
+   * \return the amount of reinsertions.
+   *
+   * \since 0.3.0
+   */
+  template <typename KeyIt, typename AabbIt>
+  auto update_batch(KeyIt firstKey, KeyIt lastKey, AabbIt firstAabb)
+      -> size_type
+  {
+    size_type reinsertedCount{0};
+
+    if (m_balancing == balancing_strategy::height) {
+      for (; firstKey != lastKey; ++firstKey, ++firstAabb) {
+        if (update(*firstKey, *firstAabb)) {
+          ++reinsertedCount;
         }
       }
 
-      const auto index1 = nodeIndices.at(iMin);
-      const auto index2 = nodeIndices.at(jMin);
+      return reinsertedCount;
+    }
 
-      const auto parentIndex = allocate_node();
-      auto& parentNode = m_nodes.at(parentIndex);
+    std::vector<bool> isMarked(m_nodeCapacity, false);
+
+    // Marks a node and its ancestors, up to the first marked ancestor.
+    const auto mark = [&](maybe_index index) {
+      while (index && !isMarked[*index]) {
+        isMarked[*index] = true;
+        index = m_nodes.at(*index).parent;
+      }
+    };
+
+    for (; firstKey != lastKey; ++firstKey, ++firstAabb) {
+      const auto it = m_indexMap.find(*firstKey);
+      if (it == m_indexMap.end()) {
+        continue;
+      }
+
+      const auto leafIndex = it->second;
+      const aabb_type& aabb = *firstAabb;
+
+      if (m_nodes.at(leafIndex).aabb.contains(aabb)) {
+        continue;
+      }
+
+      const auto parent = m_nodes.at(leafIndex).parent;
+      const auto grandparent = unlink_leaf(leafIndex);
+      if (parent) {
+        isMarked[*parent] = false;  // The parent was freed
+      }
+      mark(grandparent);
+
+      // The former ancestors are shrunk, until one is unaffected, since
+      // outdated AABBs would attract the following leaves.
+      for (auto index = grandparent; index;
+           index = m_nodes.at(*index).parent) {
+        auto& node = m_nodes.at(*index);
+        const auto bounds =
+            aabb_type::merge(m_nodes.at(node.left.value()).aabb,
+                             m_nodes.at(node.right.value()).aabb);
+        if (bounds == node.aabb) {
+          break;
+        }
+        set_aabb(node, bounds);
+      }
+
+      aabb_type fattened{aabb};
+      fattened.fatten(m_skinThickness);
+      set_aabb(m_nodes.at(leafIndex), fattened);
+
+      ++reinsertedCount;
+
+      if (m_root == std::nullopt) {
+        m_root = leafIndex;
+        continue;
+      }
+
+      const auto newParent = link_leaf(leafIndex, find_sibling(fattened));
+      isMarked.resize(m_nodeCapacity, false);
+      mark(newParent);
+
+      // The new ancestors are only enlarged, until one contains the leaf.
+      for (auto index = m_nodes.at(newParent).parent; index;
+           index = m_nodes.at(*index).parent) {
+        auto& node = m_nodes.at(*index);
+        if (node.aabb.contains(fattened)) {
+          break;
+        }
+        set_aabb(node, aabb_type::merge(node.aabb, fattened));
+      }
+    }
+
+    // Each affected internal node is restructured and refitted once.
+    if (m_root && isMarked[*m_root]) {
+      refit_marked(isMarked, true);
+    }
+
+#ifndef NDEBUG
+    validate();
+#endif
+
+    if (reinsertedCount != 0) {
+      check_quality();
+    }
+
+    return reinsertedCount;
+  }
+
+  /**
+   * \brief Updates the position of the AABB associated with the specified ID.
+   *
+   * \note This function has no effect if there is no AABB associated with the
+   * specified ID.
+   *
+   * \param key the ID associated with the AABB that will be moved.
+   * \param position the new position of the AABB associated with the specified
+   * ID.
+   * \param forceReinsert `true` if the associated AABB is forced to be
+   * reinserted into the tree.
+   *
+   * \return `true` if an AABB was updated; `false` otherwise.
+   *
+   * \since 0.1.0
+   */
+  auto relocate(const key_type& key,
+                const vector_type& position,
+                bool forceReinsert = false) -> bool
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      const auto& aabb = m_nodes.at(it->second).aabb;
+      return update(key, {position, position + aabb.size()}, forceReinsert);
+    } else {
+      return false;
+    }
+  }
+
+  /**
+   * \brief Sets the collision categories of the AABB associated with the
+   * specified ID.
+   *
+   * \note This function has no effect if there is no AABB associated with the
+   * specified ID.
+   *
+   * \param key the ID associated with the AABB.
+   * \param categories the new collision categories of the AABB.
+   *
+   * \since 0.3.0
+   */
+  void set_categories(const key_type& key, const category_mask categories)
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      m_nodes.at(it->second).categories = categories;
+      update_ancestor_augmentations(m_nodes.at(it->second).parent);
+
+#ifndef NDEBUG
+      validate();
+#endif
+    }
+  }
+
+  /**
+   * \brief Sets the aggregate value of the AABB associated with the specified
+   * ID.
+   *
+   * \note This function has no effect if there is no AABB associated with the
+   * specified ID.
+   *
+   * \param key the ID associated with the AABB.
+   * \param value the new aggregate value of the AABB.
+   *
+   * \since 0.3.0
+   */
+  void set_value(const key_type& key, const aggregate_value& value)
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      m_nodes.at(it->second).value = value;
+      update_ancestor_augmentations(m_nodes.at(it->second).parent);
+
+#ifndef NDEBUG
+      validate();
+#endif
+    }
+  }
+
+  /**
+   * \brief Rebuilds the tree with the greedy builder.
+   *
+   * \details The entries are agglomerated bottom-up by repeatedly merging the
+   * pair of nodes with the cheapest combined AABB. This is O(n^3), so it is
+   * only suitable for small trees, and the result is not optimal; the binned
+   * SAH builder is much faster and usually produces a better tree.
+   *
+   * \see `rebuild(rebuild_strategy, size_type)`
+   *
+   * \since 0.1.0
+   */
+  void rebuild()
+  {
+    auto nodeIndices = release_internal_nodes();
+    auto count = static_cast<int>(nodeIndices.size());
+
+    if (count == 0) {
+      return;
+    }
+
+    while (count > 1) {
+      auto minCost = std::numeric_limits<double>::max();
+      int iMin{-1};
+      int jMin{-1};
+
+      for (auto i = 0; i < count; ++i) {
+        const auto fstAabb = m_nodes.at(nodeIndices.at(i)).aabb;
+
+        for (auto j = (i + 1); j < count; ++j) {
+          const auto sndAabb = m_nodes.at(nodeIndices.at(j)).aabb;
+          const auto cost = cost_of(aabb_type::merge(fstAabb, sndAabb));
+
+          if (cost < minCost) {
+            iMin = i;
+            jMin = j;
+            minCost = cost;
+          }
+        }
+      }
+
+      const auto index1 = nodeIndices.at(iMin);
+      const auto index2 = nodeIndices.at(jMin);
+
+      const auto parentIndex = allocate_node();
+      auto& parentNode = m_nodes.at(parentIndex);
 
       auto& index1Node = m_nodes.at(index1);
       auto& index2Node = m_nodes.at(index2);
@@ -801,7 +1508,8 @@ class tree final
       parentNode.left = index1;
       parentNode.right = index2;
       parentNode.height = 1 + std::max(index1Node.height, index2Node.height);
-      parentNode.aabb = aabb_type::merge(index1Node.aabb, index2Node.aabb);
+      set_aabb(parentNode, aabb_type::merge(index1Node.aabb, index2Node.aabb));
+      update_augmentations(parentNode, index1Node, index2Node);
       parentNode.parent = std::nullopt;
 
       index1Node.parent = parentIndex;
@@ -813,10 +1521,314 @@ class tree final
     }
 
     m_root = nodeIndices.at(0);
+    on_rebuilt();
+
+#ifndef NDEBUG
+    validate();
+#endif
+  }
+
+  /**
+   * \brief Rebuilds the tree using the specified strategy.
+   *
+   * \details The binned SAH strategy splits the entries top-down, choosing the
+   * split that minimizes the surface area heuristic among a fixed amount of
+   * candidate splits along the axis with the largest extent. This is
+   * O(n log n), which makes it usable for large trees, unlike the greedy
+   * strategy. The LBVH strategy is even faster, but produces trees of lower
+   * quality. The PLOC strategy merges nearby clusters bottom-up, which is
+   * almost as fast as LBVH and produces trees of similar quality to SAH.
+   *
+   * \param strategy the algorithm that will be used to rebuild the tree.
+   * \param threadCount the maximum amount of threads used by the LBVH and PLOC
+   * strategies, the resulting tree does not depend on the amount of threads.
+   *
+   * \since 0.3.0
+   */
+  void rebuild(const rebuild_strategy strategy, const size_type threadCount = 1)
+  {
+    if (strategy == rebuild_strategy::greedy) {
+      rebuild();
+      return;
+    }
+
+    auto leaves = release_internal_nodes();
+    if (!leaves.empty()) {
+      switch (strategy) {
+        case rebuild_strategy::lbvh:
+          m_root = build_lbvh(leaves, threadCount);
+          break;
+
+        case rebuild_strategy::ploc:
+          m_root = build_ploc(leaves, threadCount);
+          break;
+
+        default:
+          m_root = build_binned_sah(leaves);
+          break;
+      }
+    }
+
+    on_rebuilt();
+
+#ifndef NDEBUG
+    validate();
+#endif
+  }
+
+  /**
+   * \brief Replaces the contents of the tree with a batch of AABBs.
+   *
+   * \details This is much faster than inserting the AABBs one by one, since
+   * the hierarchy is emitted in linear time from the Morton codes of the AABB
+   * centres, instead of being formed by repeated insertions.
+   *
+   * \details The sorting and hierarchy emission can be distributed over
+   * several threads, the resulting tree is the same regardless of the amount
+   * of threads.
+   *
+   * \pre The keys in the range must be unique.
+   *
+   * \tparam InputIt the type of the input iterators, the value type must be a
+   * pair-like type of a key and an AABB, e.g. `std::pair<key_type, aabb_type>`.
+   *
+   * \param first the first element of the range.
+   * \param last the element one past the last element of the range.
+   * \param threadCount the maximum amount of threads used to build the tree.
+   *
+   * \since 0.3.0
+   */
+  template <typename InputIt>
+  void build(InputIt first, InputIt last, const size_type threadCount = 1)
+  {
+    std::vector<std::pair<key_type, aabb_type>> entries{first, last};
+
+    m_indexMap.clear();
+    m_indexMap.reserve(entries.size());
+
+    // Every node in the pool is released, the tree needs 2n - 1 nodes.
+    m_root = std::nullopt;
+    m_nodeCount = 0;
+    m_nodeCapacity = std::max(m_nodeCapacity, 2 * entries.size());
+    resize_to_match_node_capacity(0);
+    m_nextFreeIndex = 0;
+    m_totalArea = 0;
+
+    std::vector<index_type> leaves;
+    leaves.reserve(entries.size());
+
+    for (const auto& [key, aabb] : entries) {
+      leaves.push_back(allocate_leaf(key, aabb));
+    }
+
+    if (!leaves.empty()) {
+      m_root = build_lbvh(leaves, threadCount);
+    }
+
+    on_rebuilt();
+
+#ifndef NDEBUG
+    validate();
+#endif
+  }
+
+  /**
+   * \brief Improves the quality of the tree by reinserting poorly placed
+   * subtrees.
+   *
+   * \details The internal nodes with the highest inefficiency, i.e. the nodes
+   * that are large compared to their children, are removed from the tree and
+   * their children are reinserted at the best positions, as described by
+   * Bittner et al. in "Fast Insertion-Based Optimization of Bounding Volume
+   * Hierarchies".
+   *
+   * Only a window of node slots, proportional to the budget, is ranked by
+   * each call. The window starts where the previous call stopped, so repeated
+   * calls cycle through the whole tree. The cost of a call therefore depends
+   * on the budget instead of the size of the tree, which makes this cheap
+   * enough to be done every frame, to counter the degradation caused by
+   * continuous updates.
+   *
+   * \param budget the maximum amount of nodes that will be reinserted.
+   *
+   * \return the amount of nodes that were reinserted.
+   *
+   * \since 0.3.0
+   */
+  auto optimize(const size_type budget) -> size_type
+  {
+    const auto window = (budget < m_nodeCapacity / optimizeWindowFactor)
+                            ? budget * optimizeWindowFactor
+                            : m_nodeCapacity;
+
+    std::vector<std::pair<double, index_type>> candidates;
+    candidates.reserve(window);
+
+    for (size_type offset = 0; offset < window; ++offset) {
+      const auto index = (m_optimizeCursor + offset) % m_nodeCapacity;
+
+      const auto& node = m_nodes.at(index);
+      if (node.height < 1 || index == m_root) {  // Free, leaf or root node.
+        continue;
+      }
+
+      candidates.emplace_back(inefficiency(node), index);
+    }
+
+    if (window != 0) {
+      m_optimizeCursor = (m_optimizeCursor + window) % m_nodeCapacity;
+    }
+
+    const auto count = std::min(budget, candidates.size());
+    const auto middle = candidates.begin() + static_cast<std::ptrdiff_t>(count);
+    std::partial_sort(candidates.begin(),
+                      middle,
+                      candidates.end(),
+                      [](const auto& a, const auto& b) {
+                        return a.first > b.first;
+                      });
+
+    // Every reinsertion frees two nodes, which are immediately reused as the
+    // new parents of the reinserted subtrees, so their ranks are outdated.
+    // A hashed set keeps the cost of a call independent of the tree size.
+    std::unordered_set<index_type> reallocated;
+    reallocated.reserve(2 * count);
+
+    size_type reinsertedCount{0};
+    for (auto it = candidates.begin(); it != middle; ++it) {
+      const auto index = it->second;
+
+      // Previous reinsertions may have freed or reused the node.
+      const auto& node = m_nodes.at(index);
+      if (node.height < 1 || index == m_root || reallocated.count(index)) {
+        continue;
+      }
+
+      auto left = node.left.value();
+      auto right = node.right.value();
+
+      // Detach the node and its children, which also frees its parent.
+      adjust_ancestor_bounds(unlink_leaf(index));
+      free_node(index);
+
+      // Reinserting the larger subtree first leads to better placements.
+      if (cost_of(m_nodes.at(left).aabb) < cost_of(m_nodes.at(right).aabb)) {
+        std::swap(left, right);
+      }
+
+      for (const auto subtree : {left, right}) {
+        const auto& aabb = m_nodes.at(subtree).aabb;
+        const auto sibling = find_best_sibling_branch_and_bound(aabb);
+
+        const auto parent = link_leaf(subtree, sibling);
+        reallocated.insert(parent);
+        fix_tree_upwards(parent);
+      }
+
+      ++reinsertedCount;
+    }
+
+#ifndef NDEBUG
+    validate();
+#endif
+
+    return reinsertedCount;
+  }
+
+  /**
+   * \brief Improves the quality of the tree by restructuring small treelets
+   * optimally.
+   *
+   * \details A treelet is formed around an internal node by repeatedly
+   * expanding the most expensive treelet leaf, until it has seven leaves. The
+   * topology of the treelet that minimizes the cost of its internal nodes is
+   * then found by dynamic programming over the subsets of its leaves, as
+   * described by Karras and Aila in "Fast Parallel Construction of
+   * High-Quality Bounding Volume Hierarchies". The existing nodes are reused,
+   * so the tree is restructured in place.
+   *
+   * Every pass selects disjoint treelets, starting at the most expensive
+   * nodes, which are then optimized in parallel. The roots of a pass aren't
+   * used as roots by the following pass, which moves the treelet boundaries.
+   *
+   * \param passes the amount of passes.
+   * \param threadCount the amount of threads that will be used.
+   *
+   * \return the amount of treelets that were restructured.
+   *
+   * \since 0.3.0
+   */
+  auto optimize_treelets(const size_type passes = 1,
+                         const size_type threadCount = 1) -> size_type
+  {
+    size_type restructuredCount{0};
+
+    std::vector<bool> isPreviousRoot(m_nodeCapacity, false);
+    for (size_type pass = 0; pass < passes; ++pass) {
+      auto treelets = select_treelets(isPreviousRoot);
+
+      const auto count = treelets.size();
+      const auto threads = effective_thread_count(count, threadCount);
+      parallel_for(count, threads, [&](auto, auto begin, auto end) {
+        std::vector<aabb_type> bounds;
+        for (auto i = begin; i < end; ++i) {
+          optimize_treelet(treelets[i], bounds);
+        }
+      });
+
+      std::fill(isPreviousRoot.begin(), isPreviousRoot.end(), false);
+      for (const auto& treelet : treelets) {
+        isPreviousRoot.at(treelet.internal.front()) = true;
+        if (treelet.isImproved) {
+          apply_treelet(treelet);
+          ++restructuredCount;
+        }
+      }
+    }
 
 #ifndef NDEBUG
     validate();
 #endif
+
+    return restructuredCount;
+  }
+
+  /**
+   * \brief Sets the strategy used to restructure the tree after insertions,
+   * removals and updates.
+   *
+   * \details The height strategy keeps the tree balanced, whilst the surface
+   * area strategy performs the local rotation that reduces the total surface
+   * area the most, which makes the tree cheaper to query over time but allows
+   * it to become deeper. Disabling the rotations makes insertions and
+   * removals cheaper and is suitable for mostly static trees that are built
+   * with a good builder, since rotations would disturb the built structure.
+   *
+   * \param strategy the new balancing strategy.
+   *
+   * \since 0.3.0
+   */
+  void set_balancing_strategy(const balancing_strategy strategy) noexcept
+  {
+    m_balancing = strategy;
+  }
+
+  /**
+   * \brief Sets the strategy used to find the position of new leaves.
+   *
+   * \details The greedy strategy descends towards the child that is cheapest
+   * to insert the leaf into, which can miss much better positions elsewhere in
+   * the tree. The branch and bound strategy finds the position that minimizes
+   * the total surface area of the tree, at the cost of visiting more nodes.
+   * The strategy applies to insertions and to reinsertions due to updates.
+   *
+   * \param strategy the new insertion strategy.
+   *
+   * \since 0.3.0
+   */
+  void set_insertion_strategy(const insertion_strategy strategy) noexcept
+  {
+    m_insertion = strategy;
   }
 
   void set_thickness_factor(std::optional<double> thicknessFactor)
@@ -849,11 +1861,15 @@ class tree final
    * for.
    * \param[out] iterator the output iterator used to write the collision
    * candidate IDs.
+   * \param mask the collision categories of interest, subtrees without any
+   * matching categories are skipped entirely.
    *
    * \since 0.1.0
    */
   template <size_type bufferSize = 256, typename OutputIterator>
-  void query(const key_type& key, OutputIterator iterator) const
+  void query(const key_type& key,
+             OutputIterator iterator,
+             const category_mask mask = all_categories) const
   {
     if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
       const auto& sourceNode = m_nodes.at(it->second);
@@ -874,6 +1890,10 @@ class tree final
 
         const auto& node = m_nodes.at(*nodeIndex);
 
+        if (!(node.categories & mask)) {
+          continue;
+        }
+
         // Test for overlap between the AABBs
         if (sourceNode.aabb.overlaps(node.aabb, m_touchIsOverlap)) {
           if (node.is_leaf() && node.id) {
@@ -890,9 +1910,529 @@ class tree final
     }
   }
 
-  [[nodiscard]] auto compute_maximum_balance() const -> size_type
-  {
-    size_type maxBalance{0};
+  /**
+   * \brief Obtains the IDs of all AABBs that overlap the supplied AABB.
+   *
+   * \note This function uses the same stackless traversal as
+   * `query_stackless()`, and never allocates.
+   *
+   * \tparam OutputIterator the type of the output iterator.
+   *
+   * \param aabb the AABB to obtain overlapping AABBs for.
+   * \param[out] iterator the output iterator used to write the IDs.
+   * \param mask the collision categories of interest.
+   *
+   * \since 0.3.0
+   */
+  template <typename OutputIterator>
+  void query(const aabb_type& aabb,
+             OutputIterator iterator,
+             const category_mask mask = all_categories) const
+  {
+    maybe_index current = m_root;
+    maybe_index previous;
+
+    while (const auto index =
+               next_overlapping_leaf(aabb, current, previous, mask)) {
+      *iterator = m_nodes.at(*index).id.value();
+      ++iterator;
+    }
+  }
+
+  /**
+   * \brief Visits the collision candidates for the AABB associated with the
+   * specified ID, along with their AABBs.
+   *
+   * \details This function is equivalent to `query()`, except that the AABB of
+   * each candidate is supplied to the visitor directly from the traversed
+   * node. This avoids having to look up each candidate with `get_aabb()`,
+   * which would require an additional hash map lookup per candidate.
+   *
+   * \note This function has no effect if the supplied key is unknown.
+   *
+   * \tparam bufferSize the size of the initial stack buffer.
+   * \tparam Visitor the type of the visitor, must be invocable with a
+   * `const key_type&` and a `const aabb_type&` argument.
+   *
+   * \param key the ID associated with the AABB to obtain collision candidates
+   * for.
+   * \param visitor the function object invoked with each candidate.
+   * \param mask the collision categories of interest.
+   *
+   * \since 0.3.0
+   */
+  template <size_type bufferSize = 256, typename Visitor>
+  void query_with_aabbs(const key_type& key,
+                        Visitor&& visitor,
+                        const category_mask mask = all_categories) const
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      const auto source = it->second;
+      const auto& sourceAabb = m_nodes.at(source).aabb;
+
+      std::array<std::byte, sizeof(index_type) * bufferSize> buffer;
+      std::pmr::monotonic_buffer_resource resource{buffer.data(),
+                                                   sizeof buffer};
+
+      pmr_stack<index_type> stack{&resource};
+      if (m_root) {
+        stack.push(*m_root);
+      }
+
+      while (!stack.empty()) {
+        const auto nodeIndex = stack.top();
+        stack.pop();
+
+        const auto& node = m_nodes.at(nodeIndex);
+        if (!(node.categories & mask) ||
+            !sourceAabb.overlaps(node.aabb, m_touchIsOverlap)) {
+          continue;
+        }
+
+        if (node.is_leaf()) {
+          if (nodeIndex != source) {  // Can't interact with itself
+            visitor(node.id.value(), node.aabb);
+          }
+        } else {
+          stack.push(node.left.value());
+          stack.push(node.right.value());
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief Obtains collision candidates for the AABB associated with the
+   * specified ID, without using an auxiliary stack.
+   *
+   * \details This function produces the same candidates as `query()`, but the
+   * tree is traversed by following the parent links of the nodes in order to
+   * backtrack. As a result, this function uses a constant amount of memory and
+   * never allocates, regardless of the height of the tree.
+   *
+   * \note This function has no effect if the supplied key is unknown.
+   *
+   * \tparam OutputIterator the type of the output iterator.
+   *
+   * \param key the ID associated with the AABB to obtain collision candidates
+   * for.
+   * \param[out] iterator the output iterator used to write the collision
+   * candidate IDs.
+   * \param mask the collision categories of interest.
+   *
+   * \since 0.3.0
+   */
+  template <typename OutputIterator>
+  void query_stackless(const key_type& key,
+                       OutputIterator iterator,
+                       const category_mask mask = all_categories) const
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      const auto& sourceAabb = m_nodes.at(it->second).aabb;
+
+      maybe_index current = m_root;
+      maybe_index previous;
+
+      while (const auto index =
+                 next_overlapping_leaf(sourceAabb, current, previous, mask)) {
+        const auto& node = m_nodes.at(*index);
+        if (node.id != key) {  // Can't interact with itself
+          *iterator = *node.id;
+          ++iterator;
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief Returns a lazily evaluated range of the collision candidates for the
+   * AABB associated with the specified ID.
+   *
+   * \details Unlike `query()`, the tree is only traversed as far as the range
+   * is iterated, which makes it cheap to stop after the first few candidates.
+   * The range doesn't allocate any memory.
+   *
+   * \note The returned range is empty if the supplied key is unknown. The range
+   * is invalidated by any modification of the tree.
+   *
+   * \param key the ID associated with the AABB to obtain collision candidates
+   * for.
+   * \param mask the collision categories of interest.
+   *
+   * \return a forward range of collision candidate IDs.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto query_range(const key_type& key,
+                                 const category_mask mask = all_categories)
+      const -> query_view
+  {
+    if (const auto it = m_indexMap.find(key); it != m_indexMap.end()) {
+      return query_view{this, it->second, mask};
+    } else {
+      return query_view{};
+    }
+  }
+
+  /**
+   * \brief Indicates whether or not any AABB in the tree overlaps the supplied
+   * AABB.
+   *
+   * \details The traversal stops at the first overlapping AABB. Children are
+   * visited in order of decreasing overlap with the supplied AABB, since larger
+   * overlaps are more likely to contain a hit, so only a handful of nodes are
+   * typically visited when there is an overlap.
+   *
+   * \tparam bufferSize the size of the initial stack buffer.
+   *
+   * \param aabb the AABB that will be checked for overlaps.
+   * \param exclude the ID of an AABB that will be ignored, e.g. the AABB of the
+   * entity that is being placed.
+   * \param mask the collision categories of interest.
+   *
+   * \return `true` if there is at least one overlapping AABB; `false`
+   * otherwise.
+   *
+   * \since 0.3.0
+   */
+  template <size_type bufferSize = 64>
+  [[nodiscard]] auto any_overlap(
+      const aabb_type& aabb,
+      const std::optional<key_type>& exclude = std::nullopt,
+      const category_mask mask = all_categories) const -> bool
+  {
+    if (m_root == std::nullopt) {
+      return false;
+    }
+
+    std::array<std::byte, sizeof(index_type) * bufferSize> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), sizeof buffer};
+
+    pmr_stack<index_type> stack{&resource};
+    stack.push(*m_root);
+
+    while (!stack.empty()) {
+      const auto& node = m_nodes.at(stack.top());
+      stack.pop();
+
+      if (!(node.categories & mask) ||
+          !node.aabb.overlaps(aabb, m_touchIsOverlap)) {
+        continue;
+      }
+
+      if (node.is_leaf()) {
+        if (node.id != exclude) {
+          return true;
+        }
+      } else {
+        const auto left = node.left.value();
+        const auto right = node.right.value();
+
+        // The child with the largest overlap is pushed last to be visited first
+        if (overlap_area(m_nodes.at(left).aabb, aabb) >
+            overlap_area(m_nodes.at(right).aabb, aabb)) {
+          stack.push(right);
+          stack.push(left);
+        } else {
+          stack.push(left);
+          stack.push(right);
+        }
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * \brief Returns the AABB that is closest to the supplied AABB.
+   *
+   * \details This is a branch-and-bound descent that keeps track of the
+   * closest AABB found so far, and prunes every subtree whose AABB is further
+   * away than that. Children are visited in order of increasing distance. No
+   * result set or heap is used.
+   *
+   * \note Distances are computed between the fattened AABBs stored in the tree,
+   * and overlapping AABBs have a distance of zero.
+   *
+   * \tparam bufferSize the size of the initial stack buffer.
+   *
+   * \param aabb the AABB to find the closest AABB to.
+   * \param exclude the ID of an AABB that will be ignored, e.g. the AABB of the
+   * entity that is searching for its neighbour.
+   * \param mask the collision categories of interest.
+   *
+   * \return the ID of the closest AABB and the squared distance to it;
+   * `std::nullopt` if there are no candidate AABBs.
+   *
+   * \since 0.3.0
+   */
+  template <size_type bufferSize = 64>
+  [[nodiscard]] auto nearest_distance(
+      const aabb_type& aabb,
+      const std::optional<key_type>& exclude = std::nullopt,
+      const category_mask mask = all_categories) const
+      -> std::optional<nearest_entry>
+  {
+    if (m_root == std::nullopt) {
+      return std::nullopt;
+    }
+
+    using bounded_index = std::pair<index_type, double>;
+
+    std::array<std::byte, sizeof(bounded_index) * bufferSize> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), sizeof buffer};
+
+    pmr_stack<bounded_index> stack{&resource};
+    stack.emplace(*m_root, distance_squared(m_nodes.at(*m_root).aabb, aabb));
+
+    std::optional<nearest_entry> best;
+
+    while (!stack.empty()) {
+      const auto [index, bound] = stack.top();
+      stack.pop();
+
+      if (best && bound >= best->distanceSquared) {
+        continue;
+      }
+
+      const auto& node = m_nodes.at(index);
+      if (!(node.categories & mask)) {
+        continue;
+      }
+
+      if (node.is_leaf()) {
+        if (node.id != exclude) {
+          best = nearest_entry{node.id.value(), bound};
+        }
+      } else {
+        const auto left = node.left.value();
+        const auto right = node.right.value();
+
+        const auto leftBound = distance_squared(m_nodes.at(left).aabb, aabb);
+        const auto rightBound = distance_squared(m_nodes.at(right).aabb, aabb);
+
+        // The closest child is pushed last in order to be visited first
+        if (leftBound < rightBound) {
+          stack.emplace(right, rightBound);
+          stack.emplace(left, leftBound);
+        } else {
+          stack.emplace(left, leftBound);
+          stack.emplace(right, rightBound);
+        }
+      }
+    }
+
+    return best;
+  }
+
+  /**
+   * \brief Returns the AABB that is closest to the supplied point.
+   *
+   * \param point the point to find the closest AABB to.
+   * \param exclude the ID of an AABB that will be ignored.
+   * \param mask the collision categories of interest.
+   *
+   * \return the ID of the closest AABB and the squared distance to it;
+   * `std::nullopt` if there are no candidate AABBs.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto nearest_distance(
+      const vector_type& point,
+      const std::optional<key_type>& exclude = std::nullopt,
+      const category_mask mask = all_categories) const
+      -> std::optional<nearest_entry>
+  {
+    return nearest_distance(aabb_type{point, point}, exclude, mask);
+  }
+
+  /**
+   * \brief Returns the amount of AABBs that overlap the supplied AABB.
+   *
+   * \details Subtrees that are fully contained in the supplied AABB are
+   * counted in constant time using the leaf counts stored in the nodes, so
+   * only the nodes along the border of the AABB are visited.
+   *
+   * \param aabb the AABB that will be checked for overlaps.
+   *
+   * \return the amount of overlapping AABBs.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto count(const aabb_type& aabb) const -> size_type
+  {
+    size_type result{0};
+    visit_subtrees(aabb, [&](const node_type& node) {
+      result += node.count;
+    });
+    return result;
+  }
+
+  /**
+   * \brief Returns the combined aggregate value of the AABBs that overlap the
+   * supplied AABB.
+   *
+   * \details Subtrees that are fully contained in the supplied AABB are folded
+   * in constant time using the aggregate values stored in the nodes.
+   *
+   * \param aabb the AABB that will be checked for overlaps.
+   *
+   * \return the combined value of all overlapping AABBs; the identity value if
+   * there are no overlapping AABBs.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto accumulate(const aabb_type& aabb) const -> aggregate_value
+  {
+    auto result = aggregate_type::identity();
+    visit_subtrees(aabb, [&](const node_type& node) {
+      result = aggregate_type::combine(result, node.value);
+    });
+    return result;
+  }
+
+  /**
+   * \brief Visits every pair of overlapping AABBs in the tree.
+   *
+   * \details The tree is traversed against itself by descending pairs of nodes
+   * simultaneously, which means that each unordered pair of overlapping AABBs
+   * is reported exactly once. This is considerably cheaper than invoking
+   * `query()` for every key in the tree.
+   *
+   * \tparam bufferSize the size of the initial stack buffer.
+   * \tparam Visitor the type of the visitor, must be invocable with two
+   * `const key_type&` arguments.
+   *
+   * \param visitor the function object that will be invoked with the keys of
+   * each pair of overlapping AABBs.
+   *
+   * \since 0.3.0
+   */
+  template <size_type bufferSize = 256, typename Visitor>
+  void query_all_pairs(Visitor&& visitor) const
+  {
+    if (m_root == std::nullopt) {
+      return;
+    }
+
+    using index_pair = std::pair<index_type, index_type>;
+
+    std::array<std::byte, sizeof(index_pair) * bufferSize> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), sizeof buffer};
+
+    pmr_stack<index_pair> stack{&resource};
+    stack.emplace(*m_root, *m_root);
+
+    while (!stack.empty()) {
+      const auto [fst, snd] = stack.top();
+      stack.pop();
+
+      const auto& fstNode = m_nodes.at(fst);
+
+      if (fst == snd) {
+        // The pairs in a subtree are the pairs in each of its children, along
+        // with the pairs that cross between the two children.
+        if (!fstNode.is_leaf()) {
+          const auto left = fstNode.left.value();
+          const auto right = fstNode.right.value();
+          stack.emplace(left, left);
+          stack.emplace(right, right);
+          stack.emplace(left, right);
+        }
+        continue;
+      }
+
+      const auto& sndNode = m_nodes.at(snd);
+      if (!fstNode.aabb.overlaps(sndNode.aabb, m_touchIsOverlap)) {
+        continue;
+      }
+
+      if (fstNode.is_leaf() && sndNode.is_leaf()) {
+        visitor(fstNode.id.value(), sndNode.id.value());
+      } else if (sndNode.is_leaf() ||
+                 (!fstNode.is_leaf() &&
+                  fstNode.aabb.area() >= sndNode.aabb.area())) {
+        // Descend into the larger node.
+        stack.emplace(fstNode.left.value(), snd);
+        stack.emplace(fstNode.right.value(), snd);
+      } else {
+        stack.emplace(fst, sndNode.left.value());
+        stack.emplace(fst, sndNode.right.value());
+      }
+    }
+  }
+
+  /**
+   * \brief Visits every pair of overlapping AABBs between this tree and
+   * another tree.
+   *
+   * \details Both trees are descended simultaneously, and pairs of nodes with
+   * AABBs that don't overlap are pruned, along with their entire subtrees. This
+   * is useful when static and dynamic entities are stored in separate trees.
+   *
+   * \tparam bufferSize the size of the initial stack buffer.
+   * \tparam OtherKey the type of the keys used by the other tree.
+   * \tparam OtherAggregate the type of the aggregate used by the other tree.
+   * \tparam OtherMetric the type of the cost metric used by the other tree.
+   * \tparam Visitor the type of the visitor, must be invocable with a
+   * `const key_type&` and a `const OtherKey&` argument, in that order.
+   *
+   * \param other the other tree, may be the same as the invoked tree.
+   * \param visitor the function object that will be invoked with the keys of
+   * each pair of overlapping AABBs.
+   *
+   * \since 0.3.0
+   */
+  template <size_type bufferSize = 256,
+            typename OtherKey,
+            typename OtherAggregate,
+            typename OtherMetric,
+            typename Visitor>
+  void query_pairs(
+      const tree<OtherKey, value_type, OtherAggregate, OtherMetric>& other,
+      Visitor&& visitor) const
+  {
+    if ((m_root == std::nullopt) || (other.m_root == std::nullopt)) {
+      return;
+    }
+
+    using index_pair = std::pair<index_type, index_type>;
+
+    std::array<std::byte, sizeof(index_pair) * bufferSize> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), sizeof buffer};
+
+    pmr_stack<index_pair> stack{&resource};
+    stack.emplace(*m_root, *other.m_root);
+
+    while (!stack.empty()) {
+      const auto [fst, snd] = stack.top();
+      stack.pop();
+
+      const auto& fstNode = m_nodes.at(fst);
+      const auto& sndNode = other.m_nodes.at(snd);
+
+      if (!fstNode.aabb.overlaps(sndNode.aabb, m_touchIsOverlap)) {
+        continue;
+      }
+
+      if (fstNode.is_leaf() && sndNode.is_leaf()) {
+        visitor(fstNode.id.value(), sndNode.id.value());
+      } else if (sndNode.is_leaf() ||
+                 (!fstNode.is_leaf() &&
+                  fstNode.aabb.area() >= sndNode.aabb.area())) {
+        // Descend into the larger node.
+        stack.emplace(fstNode.left.value(), snd);
+        stack.emplace(fstNode.right.value(), snd);
+      } else {
+        stack.emplace(fst, sndNode.left.value());
+        stack.emplace(fst, sndNode.right.value());
+      }
+    }
+  }
+
+  [[nodiscard]] auto compute_maximum_balance() const -> size_type
+  {
+    size_type maxBalance{0};
     for (auto i = 0; i < m_nodeCapacity; ++i) {
       // if (node.height <= 1) {
       //   continue;
@@ -912,24 +2452,25 @@ class tree final
     return maxBalance;
   }
 
+  /**
+   * \brief Returns the total area of all nodes divided by the area of the
+   * root, lower values indicate a tree that is cheaper to query.
+   *
+   * \details This is O(1), since the total area is maintained incrementally.
+   * The ratio is always based on the perimeters of the AABBs, regardless of
+   * the cost metric, so that trees with different metrics can be compared.
+   *
+   * \return the surface area ratio of the tree, zero if the tree is empty.
+   *
+   * \since 0.2.0
+   */
   [[nodiscard]] auto compute_surface_area_ratio() const -> double
   {
     if (m_root == std::nullopt) {
       return 0;
     }
 
-    const auto rootArea = m_nodes.at(*m_root).aabb.compute_area();
-    double totalArea{};
-
-    for (auto i = 0; i < m_nodeCapacity; ++i) {
-      const auto& node = m_nodes.at(i);
-      if (node.height < 0) {
-        continue;
-      }
-      totalArea += node.aabb.compute_area();
-    }
-
-    return totalArea / rootArea;
+    return m_totalArea / m_nodes.at(*m_root).aabb.area();
   }
 
   /**
@@ -1003,26 +2544,219 @@ class tree final
     return m_indexMap.empty();
   }
 
-  [[nodiscard]] auto thickness_factor() const noexcept -> std::optional<double>
+  /**
+   * \brief Indicates whether or not the tree contains an AABB associated with
+   * the specified ID.
+   *
+   * \param key the ID that will be checked.
+   *
+   * \return `true` if the tree contains the key; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto contains(const key_type& key) const -> bool
   {
-    return m_skinThickness;
+    return m_indexMap.count(key);
   }
 
- private:
-  std::vector<node_type> m_nodes;
-  std::unordered_map<key_type, index_type> m_indexMap;
-
-  maybe_index m_root;              ///< Root node index
-  maybe_index m_nextFreeIndex{0};  ///< Index of next free node
-
-  size_type m_nodeCount{0};  ///< Number of m_nodes in the tree.
-  size_type m_nodeCapacity;  ///< Current node capacity.
+  /**
+   * \brief Writes the key and the (fattened) AABB of every entry to an output
+   * iterator.
+   *
+   * \details The entries are found by scanning the node pool, which is much
+   * faster than iterating the key map. The order of the entries is
+   * unspecified.
+   *
+   * \tparam OutputIterator the type of the output iterator, must accept
+   * `std::pair<key_type, aabb_type>` values.
+   *
+   * \param iterator the output iterator that will receive the entries.
+   *
+   * \since 0.3.0
+   */
+  template <typename OutputIterator>
+  void collect_entries(OutputIterator iterator) const
+  {
+    for (const auto& node : m_nodes) {
+      if (node.height == 0 && node.id) {  // Allocated leaf node.
+        *iterator = std::pair<key_type, aabb_type>{*node.id, node.aabb};
+        ++iterator;
+      }
+    }
+  }
+
+  [[nodiscard]] auto thickness_factor() const noexcept -> std::optional<double>
+  {
+    return m_skinThickness;
+  }
+
+  /**
+   * \brief Returns the strategy used to restructure the tree.
+   *
+   * \return the current balancing strategy.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_balancing_strategy() const noexcept
+      -> balancing_strategy
+  {
+    return m_balancing;
+  }
+
+  /**
+   * \brief Returns the strategy used to find the position of new leaves.
+   *
+   * \return the current insertion strategy.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_insertion_strategy() const noexcept
+      -> insertion_strategy
+  {
+    return m_insertion;
+  }
+
+  /**
+   * \brief Sets the policy used to automatically maintain the tree quality.
+   *
+   * \details The quality is checked in O(1) after every insertion, removal
+   * and reinsertion, and maintenance is scheduled when needed, which is then
+   * performed by `maintain()`. The current quality is used as the baseline.
+   * The statistics are reset.
+   *
+   * \param policy the new rebuild policy, `std::nullopt` disables automatic
+   * maintenance, which is the default.
+   *
+   * \since 0.3.0
+   */
+  void set_rebuild_policy(const std::optional<rebuild_policy>& policy)
+  {
+    m_rebuildPolicy = policy;
+    m_rebuildStats = rebuild_stats{};
+    m_isMaintenancePending = false;
+    m_rebuildStats.baselineRatio = compute_surface_area_ratio();
+  }
+
+  /**
+   * \brief Returns the policy used to automatically maintain the tree quality.
+   *
+   * \return the current rebuild policy, `std::nullopt` if there is none.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_rebuild_policy() const noexcept
+      -> const std::optional<rebuild_policy>&
+  {
+    return m_rebuildPolicy;
+  }
+
+  /**
+   * \brief Restores the quality of the tree, if maintenance is pending.
+   *
+   * \details Insertions, removals and reinsertions only check the quality of
+   * the tree, which is O(1), and schedule maintenance when the rebuild policy
+   * is violated. The tree is then optimized and/or rebuilt in place by this
+   * function, which should be called at a convenient time, e.g. once per
+   * frame, so that no single mutation stalls on a rebuild.
+   *
+   * \return `true` if the tree was maintained; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto maintain() -> bool
+  {
+    if (!m_isMaintenancePending) {
+      return false;
+    }
+
+    m_isMaintenancePending = false;
+
+    // Removals may have restored the quality since maintenance was scheduled.
+    if (!m_rebuildPolicy || !is_degraded()) {
+      return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto& policy = *m_rebuildPolicy;
+    if (policy.optimizeBudget != 0) {
+      optimize(policy.optimizeBudget);
+      ++m_rebuildStats.optimizations;
+    }
+
+    if (policy.optimizeBudget == 0 || is_degraded()) {
+      rebuild(policy.strategy);
+      ++m_rebuildStats.rebuilds;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    m_rebuildStats.time +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+    return true;
+  }
+
+  /**
+   * \brief Indicates whether or not `maintain()` has pending work.
+   *
+   * \return `true` if the quality of the tree has degraded too much since it
+   * was last maintained; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto is_maintenance_pending() const noexcept -> bool
+  {
+    return m_isMaintenancePending;
+  }
+
+  /**
+   * \brief Returns statistics about the automatic maintenance of the tree.
+   *
+   * \return the statistics gathered since the rebuild policy was set.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_rebuild_stats() const noexcept -> const rebuild_stats&
+  {
+    return m_rebuildStats;
+  }
+
+ private:
+  template <typename, typename, typename, typename>
+  friend class tree;
+
+  template <typename, typename>
+  friend class async_tree;
+
+  std::vector<node_type> m_nodes;
+  std::unordered_map<key_type, index_type> m_indexMap;
+
+  maybe_index m_root;              ///< Root node index
+  maybe_index m_nextFreeIndex{0};  ///< Index of next free node
+
+  size_type m_nodeCount{0};  ///< Number of m_nodes in the tree.
+  size_type m_nodeCapacity;  ///< Current node capacity.
 
   std::optional<double> m_skinThickness{0.05};
 
   /// Does touching count as overlapping in tree queries?
   bool m_touchIsOverlap{true};
 
+  balancing_strategy m_balancing{balancing_strategy::height};
+  insertion_strategy m_insertion{insertion_strategy::greedy};
+
+  /// The sum of the areas of all allocated nodes.
+  double m_totalArea{0};
+
+  std::optional<rebuild_policy> m_rebuildPolicy;
+  rebuild_stats m_rebuildStats;
+
+  /// Has the quality degraded too much since the tree was last maintained?
+  bool m_isMaintenancePending{false};
+
+  /// The node slot at which the next call to `optimize()` starts ranking.
+  size_type m_optimizeCursor{0};
+
   void print(std::ostream& stream,
              const std::string& prefix,
              const maybe_index index,
@@ -1044,540 +2778,2877 @@ class tree final
   }
 
   /**
-   * \brief Resizes the node vector.
+   * \brief Assigns the AABB of a node and updates the total area of the tree.
    *
-   * \param beginInitIndex the index at which the function will start to
-   * initialize the `next` and `height` members of the new nodes.
-   * \param size the new size of the node vector.
+   * \param node the node that will be updated.
+   * \param aabb the new AABB of the node.
    *
-   * \since 0.2.0
+   * \since 0.3.0
    */
-  void resize_to_match_node_capacity(const size_type beginInitIndex)
+  void set_aabb(node_type& node, const aabb_type& aabb) noexcept
   {
-    m_nodes.resize(m_nodeCapacity);
-    for (auto i = beginInitIndex; i < (m_nodeCapacity - 1); ++i) {
-      auto& node = m_nodes.at(i);
-      node.next = static_cast<index_type>(i) + 1;
-      node.height = -1;
+    m_totalArea += aabb.area() - node.aabb.area();
+    node.aabb = aabb;
+  }
+
+  /**
+   * \brief Computes the sum of the areas of all allocated nodes.
+   *
+   * \details This is O(capacity), the incrementally maintained total area
+   * should be used instead whenever possible.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto compute_total_area() const -> double
+  {
+    double totalArea{0};
+
+    for (const auto& node : m_nodes) {
+      if (node.height >= 0) {
+        totalArea += node.aabb.area();
+      }
     }
 
-    auto& node = m_nodes.at(m_nodeCapacity - 1);
-    node.next = std::nullopt;
-    node.height = -1;
+    return totalArea;
   }
 
   /**
-   * \brief Doubles the size of the node pool.
+   * \brief Resets the quality baseline after the tree has been rebuilt.
    *
-   * \since 0.1.0
+   * \details The total area is recomputed from scratch, which discards any
+   * accumulated rounding errors. Pending maintenance is cancelled.
+   *
+   * \since 0.3.0
    */
-  void grow_pool()
+  void on_rebuilt()
   {
-    assert(m_nodeCount == m_nodeCapacity);
+    m_totalArea = compute_total_area();
+    m_rebuildStats.baselineRatio = compute_surface_area_ratio();
+    m_isMaintenancePending = false;
+  }
 
-    // The free list is empty. Rebuild a bigger pool.
-    m_nodeCapacity *= 2;
-    resize_to_match_node_capacity(m_nodeCount);
+  /**
+   * \brief Indicates whether or not the quality of the tree has degraded too
+   * much according to the rebuild policy.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto is_degraded() const -> bool
+  {
+    const auto limit =
+        m_rebuildPolicy->threshold * m_rebuildStats.baselineRatio;
+    return compute_surface_area_ratio() > limit;
+  }
 
-    // Assign the index of the first free node.
-    m_nextFreeIndex = static_cast<index_type>(m_nodeCount);
+  /**
+   * \brief Schedules maintenance if the quality of the tree has degraded too
+   * much according to the rebuild policy.
+   *
+   * \details This is O(1), since the total area of the tree is maintained
+   * incrementally. The maintenance itself is left to `maintain()`.
+   *
+   * \since 0.3.0
+   */
+  void check_quality()
+  {
+    if (!m_rebuildPolicy || size() < m_rebuildPolicy->minSize) {
+      return;
+    }
+
+    ++m_rebuildStats.checks;
+
+    if (is_degraded()) {
+      m_isMaintenancePending = true;
+    }
   }
 
   /**
-   * \brief Returns the index to a new node.
+   * \brief Recomputes the marked internal nodes in post-order.
    *
-   * \details This function will grow the node pool if there are no available
-   * nodes. Otherwise, this function will just increment the next free node
-   * index and return the index of the previous next free node.
+   * \details The marked nodes must form a set of paths towards the root,
+   * i.e. the parent of a marked node must also be marked.
    *
-   * \return the index of the allocated node.
+   * \param isMarked indicates whether or not each node is marked.
+   * \param isRestructured `true` if each marked node should be restructured
+   * according to the balancing strategy before it is refitted.
    *
-   * \since 0.1.0
+   * \since 0.3.0
    */
-  [[nodiscard]] auto allocate_node() -> index_type
+  void refit_marked(const std::vector<bool>& isMarked,
+                    const bool isRestructured = false)
   {
-    if (m_nextFreeIndex == std::nullopt) {
-      grow_pool();
-    }
+    assert(m_root && isMarked[*m_root]);
 
-    // Peel a node off the free list.
-    const auto nodeIndex = m_nextFreeIndex.value();
-    auto& node = m_nodes.at(nodeIndex);
+    // Pairs of node indices and whether their children have been visited.
+    std::vector<std::pair<index_type, bool>> stack;
+    stack.emplace_back(m_root.value(), false);
 
-    m_nextFreeIndex = node.next;
-    node.parent = std::nullopt;
-    node.left = std::nullopt;
-    node.right = std::nullopt;
-    node.height = 0;
-    // node.aabb.set_dimension(dimension);
-    ++m_nodeCount;
+    while (!stack.empty()) {
+      const auto [index, isExpanded] = stack.back();
+      stack.pop_back();
 
-    return nodeIndex;
+      if (isExpanded) {
+        refit_node(isRestructured ? restructure(index) : index);
+        continue;
+      }
+
+      stack.emplace_back(index, true);
+
+      const auto& node = m_nodes.at(index);
+      for (const auto child : {node.left.value(), node.right.value()}) {
+        if (isMarked[child]) {
+          stack.emplace_back(child, false);
+        }
+      }
+    }
   }
 
-  void free_node(const index_type node)
+  /**
+   * \brief Frees all internal nodes and detaches all leaves.
+   *
+   * \return the indices of all leaves.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto release_internal_nodes() -> std::vector<index_type>
   {
-    assert(node < m_nodeCapacity);
-    assert(0 < m_nodeCount);
+    std::vector<index_type> leaves;
+    leaves.reserve(m_indexMap.size());
 
-    m_nodes.at(node).next = m_nextFreeIndex;
-    m_nodes.at(node).height = -1;
+    for (index_type index = 0; index < m_nodeCapacity; ++index) {
+      auto& node = m_nodes.at(index);
+      if (node.height < 0) {  // Free node.
+        continue;
+      }
 
-    m_nextFreeIndex = node;
-    --m_nodeCount;
+      if (node.is_leaf()) {
+        node.parent = std::nullopt;
+        leaves.push_back(index);
+      } else {
+        free_node(index);
+      }
+    }
+
+    m_root = std::nullopt;
+    return leaves;
   }
 
-  [[nodiscard]] static auto left_cost(const aabb_type& leafAabb,
-                                      const node_type& leftNode,
-                                      const double minimumCost) -> double
+  /**
+   * \brief Recomputes the AABB, height and augmentations of an internal node
+   * based on its children.
+   *
+   * \param index the index of the internal node.
+   * \param trackArea `false` if the total area of the tree should not be
+   * updated, which is required when nodes are refitted concurrently.
+   *
+   * \since 0.3.0
+   */
+  void refit_node(const index_type index, const bool trackArea = true)
   {
-    if (leftNode.is_leaf()) {
-      return aabb_type::merge(leafAabb, leftNode.aabb).area() + minimumCost;
+    auto& node = m_nodes.at(index);
+    const auto& left = m_nodes.at(node.left.value());
+    const auto& right = m_nodes.at(node.right.value());
+
+    const auto aabb = aabb_type::merge(left.aabb, right.aabb);
+    if (trackArea) {
+      set_aabb(node, aabb);
     } else {
-      const auto oldArea = leftNode.aabb.area();
-      const auto newArea = aabb_type::merge(leafAabb, leftNode.aabb).area();
-      return (newArea - oldArea) + minimumCost;
+      node.aabb = aabb;
     }
+
+    node.height = 1 + std::max(left.height, right.height);
+    update_augmentations(node, left, right);
   }
 
-  [[nodiscard]] static auto right_cost(const aabb_type& leafAabb,
-                                       const node_type& rightNode,
-                                       const double minimumCost) -> double
+  /**
+   * \brief Returns the centre of an AABB along the specified axis.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] static auto centroid(const aabb_type& aabb, const int axis)
+      -> double
   {
-    if (rightNode.is_leaf()) {
-      const auto aabb = aabb_type::merge(leafAabb, rightNode.aabb);
-      return aabb.area() + minimumCost;
+    if (axis == 0) {
+      return 0.5 * (static_cast<double>(aabb.min().x) + aabb.max().x);
     } else {
-      const auto aabb = aabb_type::merge(leafAabb, rightNode.aabb);
-      const auto oldArea = rightNode.aabb.area();
-      const auto newArea = aabb.area();
-      return (newArea - oldArea) + minimumCost;
+      return 0.5 * (static_cast<double>(aabb.min().y) + aabb.max().y);
     }
   }
 
-  [[nodiscard]] auto find_best_sibling(const aabb_type& leafAabb) const
-      -> index_type
+  /**
+   * \brief Partitions a range of nodes according to the best split found by
+   * the binned surface area heuristic.
+   *
+   * \param nodes the node indices, the range will be reordered.
+   * \param begin the first index of the range.
+   * \param end the index one past the last index of the range.
+   *
+   * \return the index of the first node in the second partition, both
+   * partitions are guaranteed to be non-empty.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto partition_binned_sah(std::vector<index_type>& nodes,
+                                          const size_type begin,
+                                          const size_type end) const
+      -> size_type
   {
-    auto index = m_root.value();
+    constexpr size_type binCount = 16;
 
-    while (!m_nodes.at(index).is_leaf()) {
-      const auto& node = m_nodes.at(index);
-      const auto left = node.left.value();
-      const auto right = node.right.value();
+    assert(end - begin > 1);
 
-      const auto surfaceArea = node.aabb.area();
-      const auto combinedSurfaceArea =
-          aabb_type::merge(node.aabb, leafAabb).area();
+    std::array<double, 2> lower{std::numeric_limits<double>::max(),
+                                std::numeric_limits<double>::max()};
+    std::array<double, 2> upper{std::numeric_limits<double>::lowest(),
+                                std::numeric_limits<double>::lowest()};
 
-      // Cost of creating a new parent for this node and the new leaf.
-      const auto cost = 2.0 * combinedSurfaceArea;
+    for (auto i = begin; i < end; ++i) {
+      const auto& aabb = m_nodes.at(nodes.at(i)).aabb;
+      for (auto axis = 0; axis < 2; ++axis) {
+        lower.at(axis) = std::min(lower.at(axis), centroid(aabb, axis));
+        upper.at(axis) = std::max(upper.at(axis), centroid(aabb, axis));
+      }
+    }
 
-      // Minimum cost of pushing the leaf further down the tree.
-      const auto minimumCost = 2.0 * (combinedSurfaceArea - surfaceArea);
+    const auto axis = ((upper[0] - lower[0]) >= (upper[1] - lower[1])) ? 0 : 1;
+    const auto extent = upper.at(axis) - lower.at(axis);
 
-      const auto costLeft = left_cost(leafAabb, m_nodes.at(left), minimumCost);
-      const auto costRight =
-          right_cost(leafAabb, m_nodes.at(right), minimumCost);
+    // All centroids coincide, so any split is as good as another.
+    if (extent <= 0) {
+      return begin + (end - begin) / 2;
+    }
 
-      // Descend according to the minimum cost.
-      if ((cost < costLeft) && (cost < costRight)) {
-        break;
-      }
+    const auto binOf = [&](const index_type index) {
+      const auto offset = centroid(m_nodes.at(index).aabb, axis) - lower[axis];
+      const auto bin = static_cast<size_type>(binCount * (offset / extent));
+      return std::min(bin, binCount - 1);
+    };
 
-      // Descend.
-      if (costLeft < costRight) {
-        index = left;
-      } else {
-        index = right;
+    std::array<std::optional<aabb_type>, binCount> bounds;
+    std::array<size_type, binCount> counts{};
+
+    for (auto i = begin; i < end; ++i) {
+      const auto index = nodes.at(i);
+      const auto bin = binOf(index);
+      const auto& aabb = m_nodes.at(index).aabb;
+
+      auto& binBounds = bounds.at(bin);
+      binBounds = binBounds ? aabb_type::merge(*binBounds, aabb) : aabb;
+      ++counts.at(bin);
+    }
+
+    // Sweep from the right to obtain the cost of the right-hand sides.
+    std::array<double, binCount> rightCosts{};
+    {
+      std::optional<aabb_type> aabb;
+      size_type count{0};
+      for (auto bin = binCount - 1; bin > 0; --bin) {
+        if (bounds.at(bin)) {
+          aabb = aabb ? aabb_type::merge(*aabb, *bounds.at(bin)) : bounds[bin];
+        }
+        count += counts.at(bin);
+        rightCosts.at(bin) = aabb ? cost_of(*aabb) * count : 0;
       }
     }
 
-    return index;
-  }
+    auto bestCost = std::numeric_limits<double>::max();
+    size_type bestSplit{1};
+    {
+      std::optional<aabb_type> aabb;
+      size_type count{0};
+      for (size_type split = 1; split < binCount; ++split) {
+        const auto bin = split - 1;
+        if (bounds.at(bin)) {
+          aabb = aabb ? aabb_type::merge(*aabb, *bounds.at(bin)) : bounds[bin];
+        }
+        count += counts.at(bin);
 
-  [[nodiscard]] auto balance(const index_type nodeIndex) -> index_type
-  {
-    if (m_nodes.at(nodeIndex).is_leaf() || (m_nodes.at(nodeIndex).height < 2)) {
-      return nodeIndex;
+        const auto leftCost = aabb ? cost_of(*aabb) * count : 0;
+        const auto cost = leftCost + rightCosts.at(split);
+        if (count != 0 && count != (end - begin) && cost < bestCost) {
+          bestCost = cost;
+          bestSplit = split;
+        }
+      }
     }
 
-    const auto leftIndex = m_nodes.at(nodeIndex).left.value();
-    const auto rightIndex = m_nodes.at(nodeIndex).right.value();
+    const auto first = nodes.begin() + static_cast<std::ptrdiff_t>(begin);
+    const auto last = nodes.begin() + static_cast<std::ptrdiff_t>(end);
+    const auto middle = std::partition(first, last, [&](const index_type i) {
+      return binOf(i) < bestSplit;
+    });
 
-    assert(leftIndex < m_nodeCapacity);
-    assert(rightIndex < m_nodeCapacity);
+    return static_cast<size_type>(middle - nodes.begin());
+  }
 
-    const auto currentBalance =
-        m_nodes.at(rightIndex).height - m_nodes.at(leftIndex).height;
+  /**
+   * \brief Builds a subtree from a set of detached nodes, using the binned
+   * surface area heuristic.
+   *
+   * \details The subtree is built top-down without recursion, after which the
+   * AABBs, heights and augmentations of the new internal nodes are computed
+   * bottom-up, by visiting the internal nodes in reverse allocation order.
+   *
+   * \param nodes the indices of the nodes that will be the leaves of the
+   * subtree, must not be empty. The indices will be reordered.
+   *
+   * \return the index of the root of the new subtree.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto build_binned_sah(std::vector<index_type>& nodes)
+      -> index_type
+  {
+    struct build_task final
+    {
+      size_type begin;
+      size_type end;
+      maybe_index parent;
+      bool isLeft;
+    };
 
-    // Rotate right branch up.
-    if (currentBalance > 1) {
-      rotate_right(nodeIndex, leftIndex, rightIndex);
-      return rightIndex;
-    }
+    assert(!nodes.empty());
 
-    // Rotate left branch up.
-    if (currentBalance < -1) {
-      rotate_left(nodeIndex, leftIndex, rightIndex);
-      return leftIndex;
-    }
+    std::vector<index_type> internalNodes;
+    internalNodes.reserve(nodes.size() - 1);
 
-    return nodeIndex;
-  }
+    std::vector<build_task> tasks;
+    tasks.push_back({0, nodes.size(), std::nullopt, false});
 
-  void fix_tree_upwards(maybe_index index)
-  {
-    while (index != std::nullopt) {
-      index = balance(*index);
+    maybe_index root;
 
-      auto& node = m_nodes.at(*index);
+    while (!tasks.empty()) {
+      const auto task = tasks.back();
+      tasks.pop_back();
 
-      const auto left = node.left.value();
-      const auto right = node.right.value();
+      index_type nodeIndex;
+      if (task.end - task.begin == 1) {
+        nodeIndex = nodes.at(task.begin);
+      } else {
+        const auto middle = partition_binned_sah(nodes, task.begin, task.end);
 
-      const auto& leftNode = m_nodes.at(left);
-      const auto& rightNode = m_nodes.at(right);
+        nodeIndex = allocate_node();
+        internalNodes.push_back(nodeIndex);
 
-      node.height = 1 + std::max(leftNode.height, rightNode.height);
-      node.aabb = aabb_type::merge(leftNode.aabb, rightNode.aabb);
+        tasks.push_back({middle, task.end, nodeIndex, false});
+        tasks.push_back({task.begin, middle, nodeIndex, true});
+      }
 
-      index = node.parent;
+      m_nodes.at(nodeIndex).parent = task.parent;
+      if (task.parent) {
+        auto& parent = m_nodes.at(*task.parent);
+        if (task.isLeft) {
+          parent.left = nodeIndex;
+        } else {
+          parent.right = nodeIndex;
+        }
+      } else {
+        root = nodeIndex;
+      }
     }
-  }
 
-  void insert_leaf(const index_type leafIndex)
-  {
-    if (m_root == std::nullopt) {
-      m_root = leafIndex;
-      m_nodes.at(*m_root).parent = std::nullopt;
-      return;
+    for (auto it = internalNodes.rbegin(); it != internalNodes.rend(); ++it) {
+      refit_node(*it);
     }
 
-    // Find the best sibling for the node.
-    const auto leafAabb = m_nodes.at(leafIndex).aabb;  // copy current AABB
-    const auto siblingIndex = find_best_sibling(leafAabb);
+    return root.value();
+  }
 
-    // Create a new parent.
-    const auto oldParentIndex = m_nodes.at(siblingIndex).parent;
-    const auto newParentIndex = allocate_node();
+  /**
+   * \brief Interleaves the bits of two 16-bit coordinates into a 32-bit Morton
+   * code.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] constexpr static auto morton_code(
+      const std::uint32_t x,
+      const std::uint32_t y) noexcept -> std::uint32_t
+  {
+    const auto spread = [](std::uint32_t v) noexcept {
+      v &= 0x0000FFFFu;
+      v = (v | (v << 8u)) & 0x00FF00FFu;
+      v = (v | (v << 4u)) & 0x0F0F0F0Fu;
+      v = (v | (v << 2u)) & 0x33333333u;
+      v = (v | (v << 1u)) & 0x55555555u;
+      return v;
+    };
+
+    return spread(x) | (spread(y) << 1u);
+  }
 
-    auto& newParent = m_nodes.at(newParentIndex);
-    newParent.parent = oldParentIndex;
-    newParent.aabb = aabb_type::merge(leafAabb, m_nodes.at(siblingIndex).aabb);
-    // m_nodes[newParent].aabb.merge(leafAABB, m_nodes[sibling].aabb);
-    newParent.height = m_nodes.at(siblingIndex).height + 1;
+  /**
+   * \brief Returns the amount of leading zero bits of a 64-bit value.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] constexpr static auto count_leading_zeros(
+      std::uint64_t value) noexcept -> int
+  {
+    if (value == 0) {
+      return 64;
+    }
 
-    if (oldParentIndex != std::nullopt) {  // The sibling was not the root.
-      auto& oldParent = m_nodes.at(*oldParentIndex);
-      if (oldParent.left == siblingIndex) {
-        oldParent.left = newParentIndex;
-      } else {
-        oldParent.right = newParentIndex;
+    int count{0};
+    for (auto shift = 32; shift > 0; shift /= 2) {
+      if ((value >> (64 - shift)) == 0) {
+        count += shift;
+        value <<= static_cast<unsigned>(shift);
       }
-    } else {  // The sibling was the root.
-      m_root = newParentIndex;
     }
 
-    newParent.left = siblingIndex;
-    newParent.right = leafIndex;
-
-    m_nodes.at(siblingIndex).parent = newParentIndex;
-    m_nodes.at(leafIndex).parent = newParentIndex;
-
-    // Walk back up the tree fixing heights and AABBs.
-    fix_tree_upwards(m_nodes.at(leafIndex).parent);
+    return count;
   }
 
-  void adjust_ancestor_bounds(maybe_index index)
+  /**
+   * \brief Invokes a function for a set of contiguous chunks of a range of
+   * indices, where each chunk is processed by a separate thread.
+   *
+   * \details The first chunk is processed by the calling thread. The chunk
+   * boundaries only depend on the amount of indices and threads.
+   *
+   * \param count the amount of indices.
+   * \param threadCount the amount of chunks, i.e. threads.
+   * \param fn the function invoked as `fn(chunk, begin, end)` for each chunk.
+   *
+   * \since 0.3.0
+   */
+  template <typename Fn>
+  static void parallel_for(const size_type count,
+                           const size_type threadCount,
+                           Fn&& fn)
   {
-    while (index != std::nullopt) {
-      index = balance(*index);
+    const auto boundary = [=](const size_type chunk) {
+      return (count * chunk) / threadCount;
+    };
 
-      auto& node = m_nodes.at(*index);
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
 
-      const auto left = node.left;
-      const auto right = node.right;
-      const auto& leftNode = m_nodes.at(left.value());
-      const auto& rightNode = m_nodes.at(right.value());
+    for (size_type chunk = 1; chunk < threadCount; ++chunk) {
+      threads.emplace_back(fn, chunk, boundary(chunk), boundary(chunk + 1));
+    }
 
-      node.aabb = aabb_type::merge(leftNode.aabb, rightNode.aabb);
-      node.height = 1 + std::max(leftNode.height, rightNode.height);
+    fn(size_type{0}, boundary(0), boundary(1));
 
-      index = node.parent;
+    for (auto& thread : threads) {
+      thread.join();
     }
   }
 
-  void remove_leaf(const index_type leafIndex)
+  /**
+   * \brief Returns the amount of threads worth using to process a range.
+   *
+   * \param count the amount of elements in the range.
+   * \param threadCount the requested amount of threads.
+   *
+   * \return the requested amount of threads, limited so that small chunks
+   * aren't processed by separate threads.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] static auto effective_thread_count(const size_type count,
+                                                   const size_type threadCount)
+      -> size_type
   {
-    if (leafIndex == m_root) {
-      m_root = std::nullopt;
-      return;
-    }
+    constexpr size_type minChunkSize = 4'096;
+    return std::clamp(count / minChunkSize,
+                      size_type{1},
+                      std::max(threadCount, size_type{1}));
+  }
 
-    const auto parentIndex = m_nodes.at(leafIndex).parent;
-    const auto grandParentIndex = m_nodes.at(parentIndex.value()).parent;
+  /**
+   * \brief Sorts a set of nodes according to the Morton codes of their
+   * centres.
+   *
+   * \details The codes are sorted with an LSD radix sort, where each thread
+   * counts and scatters its own chunk of the keys. Each code is extended with
+   * the position of the node in the input, which makes every key unique, as
+   * required by the hierarchy emission. The result does not depend on the
+   * amount of threads.
+   *
+   * \param nodes the node indices, will be sorted.
+   * \param threadCount the amount of threads that will be used.
+   *
+   * \return the sorted, extended Morton codes.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto sort_by_morton_code(std::vector<index_type>& nodes,
+                                         const size_type threadCount) const
+      -> std::vector<std::uint64_t>
+  {
+    using bounds_type = std::array<double, 4>;  // lower x, lower y, upper x, y
+    constexpr auto lowest = std::numeric_limits<double>::lowest();
+    constexpr auto highest = std::numeric_limits<double>::max();
+
+    const auto count = nodes.size();
+
+    std::vector<bounds_type> chunkBounds(threadCount,
+                                         {highest, highest, lowest, lowest});
+    parallel_for(count, threadCount, [&](auto chunk, auto begin, auto end) {
+      auto& bounds = chunkBounds[chunk];
+      for (auto i = begin; i < end; ++i) {
+        const auto& aabb = m_nodes[nodes[i]].aabb;
+        for (auto axis = 0; axis < 2; ++axis) {
+          bounds[axis] = std::min(bounds[axis], centroid(aabb, axis));
+          bounds[axis + 2] = std::max(bounds[axis + 2], centroid(aabb, axis));
+        }
+      }
+    });
 
-    const auto siblingIndex =
-        (m_nodes.at(parentIndex.value()).left == leafIndex)
-            ? m_nodes.at(parentIndex.value()).right
-            : m_nodes.at(parentIndex.value()).left;
+    bounds_type bounds{highest, highest, lowest, lowest};
+    for (const auto& chunk : chunkBounds) {
+      for (auto axis = 0; axis < 2; ++axis) {
+        bounds[axis] = std::min(bounds[axis], chunk[axis]);
+        bounds[axis + 2] = std::max(bounds[axis + 2], chunk[axis + 2]);
+      }
+    }
 
-    // Destroy the parent and connect the sibling to the grandparent.
-    if (grandParentIndex != std::nullopt) {
-      if (m_nodes.at(*grandParentIndex).left == parentIndex) {
-        m_nodes.at(*grandParentIndex).left = siblingIndex;
-      } else {
-        m_nodes.at(*grandParentIndex).right = siblingIndex;
+    const auto quantize = [&](const aabb_type& aabb, const int axis) {
+      constexpr double maxCoordinate = 0xFFFF;
+      const auto extent = bounds[axis + 2] - bounds[axis];
+      if (extent <= 0) {
+        return std::uint32_t{0};
       }
 
-      m_nodes.at(siblingIndex.value()).parent = grandParentIndex;
-      free_node(parentIndex.value());
+      const auto offset = centroid(aabb, axis) - bounds[axis];
+      return static_cast<std::uint32_t>(maxCoordinate * (offset / extent));
+    };
+
+    // The upper half of each key is the Morton code, the lower half is the
+    // position of the node in the input.
+    std::vector<std::uint64_t> keys(count);
+    parallel_for(count, threadCount, [&](auto, auto begin, auto end) {
+      for (auto i = begin; i < end; ++i) {
+        const auto& aabb = m_nodes[nodes[i]].aabb;
+        const auto code = morton_code(quantize(aabb, 0), quantize(aabb, 1));
+        keys[i] = (std::uint64_t{code} << 32u) | i;
+      }
+    });
+
+    // Only the Morton codes need to be sorted, since the positions are
+    // already in ascending order and the sort is stable.
+    using histogram_type = std::array<size_type, 256>;
+    std::vector<histogram_type> histograms(threadCount);
+    std::vector<std::uint64_t> buffer(count);
+
+    for (auto shift = 32u; shift < 64u; shift += 8u) {
+      parallel_for(count, threadCount, [&](auto chunk, auto begin, auto end) {
+        auto& histogram = histograms[chunk];
+        histogram.fill(0);
+        for (auto i = begin; i < end; ++i) {
+          ++histogram[(keys[i] >> shift) & 0xFFu];
+        }
+      });
+
+      // Turn the counts into the offsets at which each chunk writes each digit.
+      size_type offset{0};
+      for (size_type digit = 0; digit < 256; ++digit) {
+        for (auto& histogram : histograms) {
+          const auto digitCount = histogram[digit];
+          histogram[digit] = offset;
+          offset += digitCount;
+        }
+      }
 
-      // Adjust ancestor bounds.
-      adjust_ancestor_bounds(grandParentIndex);
-    } else {
-      m_root = siblingIndex;
-      m_nodes.at(siblingIndex.value()).parent = std::nullopt;
-      free_node(parentIndex.value());
+      parallel_for(count, threadCount, [&](auto chunk, auto begin, auto end) {
+        auto& offsets = histograms[chunk];
+        for (auto i = begin; i < end; ++i) {
+          buffer[offsets[(keys[i] >> shift) & 0xFFu]++] = keys[i];
+        }
+      });
+
+      keys.swap(buffer);
     }
+
+    std::vector<index_type> sorted(count);
+    parallel_for(count, threadCount, [&](auto, auto begin, auto end) {
+      for (auto i = begin; i < end; ++i) {
+        sorted[i] = nodes[keys[i] & 0xFFFFFFFFu];
+      }
+    });
+    nodes.swap(sorted);
+
+    return keys;
   }
 
-  void rotate_right(const index_type nodeIndex,
-                    const index_type leftIndex,
-                    const index_type rightIndex)
+  /**
+   * \brief Builds a subtree from a set of detached nodes, using the linear
+   * BVH algorithm.
+   *
+   * \details The nodes are sorted by the Morton codes of their centres, after
+   * which the hierarchy is emitted from the sorted order in linear time, as
+   * described by Karras in "Maximizing Parallelism in the Construction of
+   * BVHs, Octrees, and k-d Trees". The AABBs are then computed bottom-up, by
+   * walking from each leaf towards the root, where the second visit of an
+   * internal node refits it and continues upwards.
+   *
+   * Every step except for the allocation of the internal nodes is
+   * distributed over the threads. The structure of the resulting subtree does
+   * not depend on the amount of threads.
+   *
+   * \param nodes the indices of the nodes that will be the leaves of the
+   * subtree, must not be empty. The indices will be reordered.
+   * \param threadCount the amount of threads that will be used.
+   *
+   * \return the index of the root of the new subtree.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto build_lbvh(std::vector<index_type>& nodes,
+                                size_type threadCount = 1) -> index_type
   {
-    auto& node = m_nodes.at(nodeIndex);
-    auto& rightNode = m_nodes.at(rightIndex);
+    assert(!nodes.empty());
+    assert(nodes.size() <= std::numeric_limits<std::uint32_t>::max());
 
-    const auto rightLeft = rightNode.left.value();
-    const auto rightRight = rightNode.right.value();
+    const auto count = static_cast<std::ptrdiff_t>(nodes.size());
+    if (count == 1) {
+      m_nodes.at(nodes.front()).parent = std::nullopt;
+      return nodes.front();
+    }
 
-    assert(rightLeft < m_nodeCapacity);
-    assert(rightRight < m_nodeCapacity);
+    threadCount = effective_thread_count(nodes.size(), threadCount);
 
-    // Swap node and its right-hand child.
-    rightNode.left = nodeIndex;
-    rightNode.parent = node.parent;
-    node.parent = rightIndex;
+    const auto keys = sort_by_morton_code(nodes, threadCount);
 
-    // The node's old parent should now point to its right-hand child.
-    if (rightNode.parent != std::nullopt) {
-      auto& rightParent = m_nodes.at(*rightNode.parent);
-      if (rightParent.left == nodeIndex) {
-        rightParent.left = rightIndex;
-      } else {
-        assert(rightParent.right == nodeIndex);
-        rightParent.right = rightIndex;
+    // The length of the common prefix of two keys, or -1 if j is out of range.
+    const auto delta = [&](const std::ptrdiff_t i, const std::ptrdiff_t j) {
+      if (j < 0 || j >= count) {
+        return -1;
       }
-    } else {
-      m_root = rightIndex;
-    }
 
-    auto& leftNode = m_nodes.at(leftIndex);
-    auto& rightRightNode = m_nodes.at(rightRight);
-    auto& rightLeftNode = m_nodes.at(rightLeft);
+      const auto a = static_cast<size_type>(i);
+      const auto b = static_cast<size_type>(j);
+      return count_leading_zeros(keys[a] ^ keys[b]);
+    };
 
-    // Rotate.
-    if (rightLeftNode.height > rightRightNode.height) {
-      rightNode.right = rightLeft;
-      node.right = rightRight;
+    std::vector<index_type> internalNodes(nodes.size() - 1);
+    for (auto& index : internalNodes) {
+      index = allocate_node();
+    }
 
-      rightRightNode.parent = nodeIndex;
+    const auto emit = [&](const std::ptrdiff_t i) {
+      // Determine the direction of the range covered by the node.
+      const std::ptrdiff_t d = (delta(i, i + 1) >= delta(i, i - 1)) ? 1 : -1;
 
-      node.aabb = aabb_type::merge(leftNode.aabb, rightRightNode.aabb);
-      rightNode.aabb = aabb_type::merge(node.aabb, rightLeftNode.aabb);
+      // Compute an upper bound for the length of the range.
+      const auto minDelta = delta(i, i - d);
+      std::ptrdiff_t maxLength = 2;
+      while (delta(i, i + (maxLength * d)) > minDelta) {
+        maxLength *= 2;
+      }
 
-      node.height = 1 + std::max(leftNode.height, rightRightNode.height);
-      rightNode.height = 1 + std::max(node.height, rightLeftNode.height);
-    } else {
-      rightNode.right = rightRight;
-      node.right = rightLeft;
+      // Find the other end of the range using binary search.
+      std::ptrdiff_t length = 0;
+      for (auto t = maxLength / 2; t >= 1; t /= 2) {
+        if (delta(i, i + ((length + t) * d)) > minDelta) {
+          length += t;
+        }
+      }
+      const auto j = i + (length * d);
+
+      // Find the split position using binary search.
+      const auto nodeDelta = delta(i, j);
+      std::ptrdiff_t split = 0;
+      auto t = length;
+      do {
+        t = (t + 1) / 2;
+        if (delta(i, i + ((split + t) * d)) > nodeDelta) {
+          split += t;
+        }
+      } while (t > 1);
+      const auto gamma = i + (split * d) + std::min(d, std::ptrdiff_t{0});
+
+      const auto childIndex = [&](const std::ptrdiff_t position,
+                                  const bool isLeaf) {
+        const auto k = static_cast<size_type>(position);
+        return isLeaf ? nodes[k] : internalNodes[k];
+      };
+
+      const auto nodeIndex = internalNodes[static_cast<size_type>(i)];
+      const auto left = childIndex(gamma, std::min(i, j) == gamma);
+      const auto right = childIndex(gamma + 1, std::max(i, j) == gamma + 1);
+
+      // Every node has a single parent, so the threads never write to the same
+      // node.
+      auto& node = m_nodes[nodeIndex];
+      node.left = left;
+      node.right = right;
+      m_nodes[left].parent = nodeIndex;
+      m_nodes[right].parent = nodeIndex;
+    };
+
+    parallel_for(internalNodes.size(),
+                 threadCount,
+                 [&](auto, auto begin, auto end) {
+                   for (auto i = begin; i < end; ++i) {
+                     emit(static_cast<std::ptrdiff_t>(i));
+                   }
+                 });
+
+    const auto root = internalNodes.front();
+    m_nodes.at(root).parent = std::nullopt;
+
+    // The total area is updated separately, since the threads would race.
+    for (const auto index : internalNodes) {
+      m_totalArea -= m_nodes[index].aabb.area();
+    }
 
-      rightLeftNode.parent = nodeIndex;
+    // The first visitor of an internal node stops, the second one refits the
+    // node, at which point both children are guaranteed to be complete.
+    std::vector<std::atomic<bool>> visited(m_nodeCapacity);
+    parallel_for(nodes.size(), threadCount, [&](auto, auto begin, auto end) {
+      for (auto i = begin; i < end; ++i) {
+        auto parent = m_nodes[nodes[i]].parent;
+        while (parent) {
+          if (!visited[*parent].exchange(true, std::memory_order_acq_rel)) {
+            break;
+          }
 
-      node.aabb = aabb_type::merge(leftNode.aabb, rightLeftNode.aabb);
-      rightNode.aabb = aabb_type::merge(node.aabb, rightRightNode.aabb);
+          refit_node(*parent, false);
+          parent = m_nodes[*parent].parent;
+        }
+      }
+    });
 
-      node.height = 1 + std::max(leftNode.height, rightLeftNode.height);
-      rightNode.height = 1 + std::max(node.height, rightRightNode.height);
+    for (const auto index : internalNodes) {
+      m_totalArea += m_nodes[index].aabb.area();
     }
+
+    return root;
   }
 
-  void rotate_left(const index_type nodeIndex,
-                   const index_type leftIndex,
-                   const index_type rightIndex)
+  /**
+   * \brief Builds a subtree from a set of detached nodes, using parallel
+   * locally-ordered clustering.
+   *
+   * \details The nodes are sorted by the Morton codes of their centres, which
+   * places nearby nodes close to each other. Every cluster then looks for
+   * the cluster within a small window around it that minimizes the cost of
+   * their merged AABB, and mutual nearest neighbours are merged. This is
+   * repeated until a single cluster remains. See "Parallel Locally-Ordered
+   * Clustering for Bounding Volume Hierarchy Construction" by Meister and
+   * Bittner.
+   *
+   * The nearest neighbour searches are distributed over the threads, while
+   * the merges are performed serially. Ties are resolved in favour of the
+   * closest position, and then of the preceding one, so the structure of the
+   * resulting subtree does not depend on the amount of threads.
+   *
+   * \param nodes the indices of the nodes that will be the leaves of the
+   * subtree, must not be empty. The indices will be reordered.
+   * \param threadCount the amount of threads that will be used.
+   *
+   * \return the index of the root of the new subtree.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto build_ploc(std::vector<index_type>& nodes,
+                                size_type threadCount = 1) -> index_type
   {
-    auto& node = m_nodes.at(nodeIndex);
-    auto& leftNode = m_nodes.at(leftIndex);
-
-    const auto leftLeft = leftNode.left.value();
-    const auto leftRight = leftNode.right.value();
+    constexpr size_type radius = 8;
 
-    assert(leftLeft < m_nodeCapacity);
-    assert(leftRight < m_nodeCapacity);
+    assert(!nodes.empty());
 
-    // Swap node and its left-hand child.
-    leftNode.left = nodeIndex;
-    leftNode.parent = node.parent;
-    node.parent = leftIndex;
+    threadCount = effective_thread_count(nodes.size(), threadCount);
+    static_cast<void>(sort_by_morton_code(nodes, threadCount));
 
-    // The node's old parent should now point to its left-hand child.
-    if (leftNode.parent != std::nullopt) {
-      auto& leftParent = m_nodes.at(*leftNode.parent);
-      if (leftParent.left == nodeIndex) {
-        leftParent.left = leftIndex;
-      } else {
-        assert(leftParent.right == nodeIndex);
-        leftParent.right = leftIndex;
-      }
-    } else {
-      m_root = leftIndex;
+    // The cluster AABBs are stored contiguously to speed up the searches.
+    std::vector<index_type> clusters{nodes};
+    std::vector<aabb_type> bounds;
+    bounds.reserve(clusters.size());
+    for (const auto index : clusters) {
+      bounds.push_back(m_nodes.at(index).aabb);
     }
 
-    auto& rightNode = m_nodes.at(rightIndex);
-    auto& leftLeftNode = m_nodes.at(leftLeft);
-    auto& leftRightNode = m_nodes.at(leftRight);
+    std::vector<index_type> merged;
+    std::vector<aabb_type> mergedBounds;
+    std::vector<size_type> nearest(clusters.size());
 
-    // Rotate.
-    if (leftLeftNode.height > leftRightNode.height) {
-      leftNode.right = leftLeft;
-      node.left = leftRight;
+    while (clusters.size() > 1) {
+      const auto count = clusters.size();
 
-      leftRightNode.parent = nodeIndex;
+      parallel_for(count, threadCount, [&](auto, auto begin, auto end) {
+        for (auto i = begin; i < end; ++i) {
+          const auto& aabb = bounds[i];
 
-      node.aabb = aabb_type::merge(rightNode.aabb, leftRightNode.aabb);
-      leftNode.aabb = aabb_type::merge(node.aabb, leftLeftNode.aabb);
+          auto bestCost = std::numeric_limits<double>::max();
+          auto best = i;
 
-      node.height = 1 + std::max(rightNode.height, leftRightNode.height);
-      leftNode.height = 1 + std::max(node.height, leftLeftNode.height);
-    } else {
+          const auto consider = [&](const size_type j) {
+            const auto cost = cost_of(aabb_type::merge(aabb, bounds[j]));
+            if (cost < bestCost) {
+              bestCost = cost;
+              best = j;
+            }
+          };
+
+          // The window is scanned outwards, so that ties keep the closest
+          // position (and the preceding one, if both are equally close).
+          for (size_type offset = 1; offset <= radius; ++offset) {
+            if (offset <= i) {
+              consider(i - offset);
+            }
+            if (i + offset < count) {
+              consider(i + offset);
+            }
+          }
+
+          nearest[i] = best;
+        }
+      });
+
+      // The merged node takes the place of the first cluster of the pair.
+      merged.clear();
+      mergedBounds.clear();
+      for (size_type i = 0; i < count; ++i) {
+        const auto j = nearest[i];
+        if (nearest[j] != i) {
+          merged.push_back(clusters[i]);
+          mergedBounds.push_back(bounds[i]);
+        } else if (i < j) {
+          const auto nodeIndex = allocate_node();
+
+          auto& node = m_nodes.at(nodeIndex);
+          node.left = clusters[i];
+          node.right = clusters[j];
+
+          m_nodes.at(clusters[i]).parent = nodeIndex;
+          m_nodes.at(clusters[j]).parent = nodeIndex;
+
+          refit_node(nodeIndex);
+          merged.push_back(nodeIndex);
+          mergedBounds.push_back(node.aabb);
+        }
+      }
+
+      assert(merged.size() < count);
+      clusters.swap(merged);
+      bounds.swap(mergedBounds);
+    }
+
+    const auto root = clusters.front();
+    m_nodes.at(root).parent = std::nullopt;
+
+    return root;
+  }
+
+  /**
+   * \brief Updates the subtree augmentations of an internal node, i.e. the
+   * category mask, leaf count and aggregate value, based on its children.
+   *
+   * \param node the internal node that will be updated.
+   * \param fst the first child of the node.
+   * \param snd the second child of the node.
+   *
+   * \since 0.3.0
+   */
+  static void update_augmentations(node_type& node,
+                                   const node_type& fst,
+                                   const node_type& snd)
+  {
+    node.categories = fst.categories | snd.categories;
+    node.count = fst.count + snd.count;
+    node.value = aggregate_type::combine(fst.value, snd.value);
+  }
+
+  /**
+   * \brief Updates the subtree augmentations of a node and all of its
+   * ancestors, without affecting their AABBs.
+   *
+   * \param index the index of the first node that will be updated.
+   *
+   * \since 0.3.0
+   */
+  void update_ancestor_augmentations(maybe_index index)
+  {
+    while (index != std::nullopt) {
+      auto& node = m_nodes.at(*index);
+      update_augmentations(node,
+                           m_nodes.at(node.left.value()),
+                           m_nodes.at(node.right.value()));
+      index = node.parent;
+    }
+  }
+
+  /**
+   * \brief Visits the largest subtrees that are contained in an AABB, along
+   * with the leaves that overlap the AABB without being contained in it.
+   *
+   * \tparam Visitor the type of the visitor, invoked with `const node_type&`.
+   *
+   * \param aabb the AABB that the subtrees must overlap.
+   * \param visitor the function object invoked with each visited node.
+   *
+   * \since 0.3.0
+   */
+  template <typename Visitor>
+  void visit_subtrees(const aabb_type& aabb, Visitor&& visitor) const
+  {
+    if (m_root == std::nullopt) {
+      return;
+    }
+
+    std::array<std::byte, sizeof(index_type) * 64> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), sizeof buffer};
+
+    pmr_stack<index_type> stack{&resource};
+    stack.push(*m_root);
+
+    while (!stack.empty()) {
+      const auto& node = m_nodes.at(stack.top());
+      stack.pop();
+
+      if (!node.aabb.overlaps(aabb, m_touchIsOverlap)) {
+        continue;
+      }
+
+      if (node.is_leaf() || aabb.contains(node.aabb)) {
+        visitor(node);
+      } else {
+        stack.push(node.left.value());
+        stack.push(node.right.value());
+      }
+    }
+  }
+
+  /**
+   * \brief Advances a stackless traversal to the next leaf that overlaps the
+   * supplied AABB.
+   *
+   * \details The traversal state consists of the current node and the
+   * previously visited node. Arriving at a node from its parent means that the
+   * node should be entered, arriving from the left child means that the right
+   * child should be visited next, and arriving from the right child means that
+   * the node is done.
+   *
+   * \param aabb the AABB that the leaves must overlap.
+   * \param current the node that will be visited next, set to the root in order
+   * to start a new traversal.
+   * \param previous the node that was previously visited, set to `std::nullopt`
+   * in order to start a new traversal.
+   * \param mask the collision categories of interest.
+   *
+   * \return the index of the next overlapping leaf; `std::nullopt` if the
+   * traversal is done.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto next_overlapping_leaf(
+      const aabb_type& aabb,
+      maybe_index& current,
+      maybe_index& previous,
+      const category_mask mask = all_categories) const -> maybe_index
+  {
+    while (current != std::nullopt) {
+      const auto index = *current;
+      const auto& node = m_nodes.at(index);
+
+      if (previous == node.parent) {
+        previous = current;
+        if (!(node.categories & mask) ||
+            !node.aabb.overlaps(aabb, m_touchIsOverlap)) {
+          current = node.parent;
+        } else if (node.is_leaf()) {
+          current = node.parent;
+          return index;
+        } else {
+          current = node.left;
+        }
+      } else if (previous == node.left) {
+        previous = current;
+        current = node.right;
+      } else {
+        previous = current;
+        current = node.parent;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  /**
+   * \brief Returns the area of the intersection of two AABBs.
+   *
+   * \param fst the first AABB.
+   * \param snd the second AABB.
+   *
+   * \return the area of the intersection; zero if the AABBs don't overlap.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] static auto overlap_area(const aabb_type& fst,
+                                         const aabb_type& snd) noexcept
+      -> double
+  {
+    const auto width = std::min(fst.max().x, snd.max().x) -
+                       std::max(fst.min().x, snd.min().x);
+    const auto height = std::min(fst.max().y, snd.max().y) -
+                        std::max(fst.min().y, snd.min().y);
+
+    if (width <= 0 || height <= 0) {
+      return 0;
+    } else {
+      return static_cast<double>(width) * static_cast<double>(height);
+    }
+  }
+
+  /**
+   * \brief Returns the squared distance between two AABBs.
+   *
+   * \param fst the first AABB.
+   * \param snd the second AABB.
+   *
+   * \return the squared distance between the closest points of the AABBs; zero
+   * if the AABBs overlap.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] static auto distance_squared(const aabb_type& fst,
+                                             const aabb_type& snd) noexcept
+      -> double
+  {
+    const auto dx = static_cast<double>(std::max(
+        {value_type{0}, fst.min().x - snd.max().x, snd.min().x - fst.max().x}));
+    const auto dy = static_cast<double>(std::max(
+        {value_type{0}, fst.min().y - snd.max().y, snd.min().y - fst.max().y}));
+    return (dx * dx) + (dy * dy);
+  }
+
+  /**
+   * \brief Resizes the node vector.
+   *
+   * \param beginInitIndex the index at which the function will start to
+   * initialize the `next` and `height` members of the new nodes.
+   * \param size the new size of the node vector.
+   *
+   * \since 0.2.0
+   */
+  void resize_to_match_node_capacity(const size_type beginInitIndex)
+  {
+    m_nodes.resize(m_nodeCapacity);
+    for (auto i = beginInitIndex; i < (m_nodeCapacity - 1); ++i) {
+      auto& node = m_nodes.at(i);
+      node.next = static_cast<index_type>(i) + 1;
+      node.height = -1;
+    }
+
+    auto& node = m_nodes.at(m_nodeCapacity - 1);
+    node.next = std::nullopt;
+    node.height = -1;
+  }
+
+  /**
+   * \brief Doubles the size of the node pool.
+   *
+   * \since 0.1.0
+   */
+  void grow_pool()
+  {
+    assert(m_nodeCount == m_nodeCapacity);
+
+    // The free list is empty. Rebuild a bigger pool.
+    m_nodeCapacity *= 2;
+    resize_to_match_node_capacity(m_nodeCount);
+
+    // Assign the index of the first free node.
+    m_nextFreeIndex = static_cast<index_type>(m_nodeCount);
+  }
+
+  /**
+   * \brief Returns the index to a new node.
+   *
+   * \details This function will grow the node pool if there are no available
+   * nodes. Otherwise, this function will just increment the next free node
+   * index and return the index of the previous next free node.
+   *
+   * \return the index of the allocated node.
+   *
+   * \since 0.1.0
+   */
+  [[nodiscard]] auto allocate_node() -> index_type
+  {
+    if (m_nextFreeIndex == std::nullopt) {
+      grow_pool();
+    }
+
+    // Peel a node off the free list.
+    const auto nodeIndex = m_nextFreeIndex.value();
+    auto& node = m_nodes.at(nodeIndex);
+
+    m_nextFreeIndex = node.next;
+    node.parent = std::nullopt;
+    node.left = std::nullopt;
+    node.right = std::nullopt;
+    node.height = 0;
+    // node.aabb.set_dimension(dimension);
+    ++m_nodeCount;
+
+    // The stale AABB is included until the node is given a new AABB.
+    m_totalArea += node.aabb.area();
+
+    return nodeIndex;
+  }
+
+  /**
+   * \brief Allocates a detached leaf node and associates it with a key.
+   *
+   * \pre `key` cannot be in use at the time of invoking this function.
+   *
+   * \param key the ID that will be associated with the leaf.
+   * \param aabb the AABB of the leaf, before fattening.
+   * \param categories the collision categories of the leaf.
+   * \param value the aggregate value associated with the leaf.
+   *
+   * \return the index of the leaf.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto allocate_leaf(
+      const key_type& key,
+      const aabb_type& aabb,
+      const category_mask categories = all_categories,
+      const aggregate_value& value = aggregate_type::identity()) -> index_type
+  {
+    // Make sure the particle doesn't already exist
+    assert(!m_indexMap.count(key));
+
+    const auto nodeIndex = allocate_node();
+    auto& node = m_nodes.at(nodeIndex);
+    node.id = key;
+    auto fattened = aabb;
+    fattened.fatten(m_skinThickness);
+    set_aabb(node, fattened);
+    node.height = 0;
+    node.categories = categories;
+    node.count = 1;
+    node.value = value;
+
+    m_indexMap.emplace(key, nodeIndex);
+
+    return nodeIndex;
+  }
+
+  void free_node(const index_type node)
+  {
+    assert(node < m_nodeCapacity);
+    assert(0 < m_nodeCount);
+
+    m_nodes.at(node).next = m_nextFreeIndex;
+    m_nodes.at(node).height = -1;
+    m_totalArea -= m_nodes.at(node).aabb.area();
+
+    m_nextFreeIndex = node;
+    --m_nodeCount;
+  }
+
+  /**
+   * \brief Returns the cost of an AABB according to the cost metric.
+   *
+   * \param aabb the AABB that will be evaluated.
+   *
+   * \return the cost of the AABB.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] static auto cost_of(const aabb_type& aabb) -> double
+  {
+    return cost_metric::cost(aabb);
+  }
+
+  [[nodiscard]] static auto left_cost(const aabb_type& leafAabb,
+                                      const node_type& leftNode,
+                                      const double minimumCost) -> double
+  {
+    if (leftNode.is_leaf()) {
+      return cost_of(aabb_type::merge(leafAabb, leftNode.aabb)) + minimumCost;
+    } else {
+      const auto oldArea = cost_of(leftNode.aabb);
+      const auto newArea = cost_of(aabb_type::merge(leafAabb, leftNode.aabb));
+      return (newArea - oldArea) + minimumCost;
+    }
+  }
+
+  [[nodiscard]] static auto right_cost(const aabb_type& leafAabb,
+                                       const node_type& rightNode,
+                                       const double minimumCost) -> double
+  {
+    if (rightNode.is_leaf()) {
+      const auto aabb = aabb_type::merge(leafAabb, rightNode.aabb);
+      return cost_of(aabb) + minimumCost;
+    } else {
+      const auto aabb = aabb_type::merge(leafAabb, rightNode.aabb);
+      const auto oldArea = cost_of(rightNode.aabb);
+      const auto newArea = cost_of(aabb);
+      return (newArea - oldArea) + minimumCost;
+    }
+  }
+
+  /**
+   * \brief Returns the sibling that minimizes the total cost of the tree if a
+   * node with the specified AABB was inserted next to it.
+   *
+   * \details This is a branch and bound search, where the most promising nodes
+   * are explored first. The cost of a sibling is the area of the new parent
+   * plus the area that is added to the ancestors of the sibling, which grows
+   * monotonically when descending. As a result, subtrees whose lower bound
+   * exceeds the best cost found so far can be skipped. Unlike
+   * `find_best_sibling()`, this finds the optimal sibling.
+   *
+   * \param aabb the AABB of the node that will be inserted.
+   *
+   * \return the index of the best sibling.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto find_best_sibling_branch_and_bound(
+      const aabb_type& aabb) const -> index_type
+  {
+    // Pairs of the area added to the ancestors of a node and the node index.
+    using candidate_type = std::pair<double, index_type>;
+    std::priority_queue<candidate_type,
+                        std::vector<candidate_type>,
+                        std::greater<>>
+        candidates;
+
+    const auto area = cost_of(aabb);
+
+    auto bestSibling = m_root.value();
+    auto bestCost =
+        cost_of(aabb_type::merge(m_nodes.at(bestSibling).aabb, aabb));
+
+    candidates.emplace(0.0, bestSibling);
+    while (!candidates.empty()) {
+      auto [inheritedCost, index] = candidates.top();
+      candidates.pop();
+
+      // The candidates are ordered by their lower bound.
+      if (inheritedCost + area >= bestCost) {
+        break;
+      }
+
+      const auto& node = m_nodes.at(index);
+      const auto directCost = cost_of(aabb_type::merge(node.aabb, aabb));
+
+      const auto cost = directCost + inheritedCost;
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestSibling = index;
+      }
+
+      inheritedCost += directCost - cost_of(node.aabb);
+      if (!node.is_leaf() && (inheritedCost + area < bestCost)) {
+        candidates.emplace(inheritedCost, node.left.value());
+        candidates.emplace(inheritedCost, node.right.value());
+      }
+    }
+
+    return bestSibling;
+  }
+
+  [[nodiscard]] auto find_best_sibling(const aabb_type& leafAabb) const
+      -> index_type
+  {
+    auto index = m_root.value();
+
+    while (!m_nodes.at(index).is_leaf()) {
+      const auto& node = m_nodes.at(index);
+      const auto left = node.left.value();
+      const auto right = node.right.value();
+
+      const auto surfaceArea = cost_of(node.aabb);
+      const auto combinedSurfaceArea =
+          cost_of(aabb_type::merge(node.aabb, leafAabb));
+
+      // Cost of creating a new parent for this node and the new leaf.
+      const auto cost = 2.0 * combinedSurfaceArea;
+
+      // Minimum cost of pushing the leaf further down the tree.
+      const auto minimumCost = 2.0 * (combinedSurfaceArea - surfaceArea);
+
+      const auto costLeft = left_cost(leafAabb, m_nodes.at(left), minimumCost);
+      const auto costRight =
+          right_cost(leafAabb, m_nodes.at(right), minimumCost);
+
+      // Descend according to the minimum cost.
+      if ((cost < costLeft) && (cost < costRight)) {
+        break;
+      }
+
+      // Descend.
+      if (costLeft < costRight) {
+        index = left;
+      } else {
+        index = right;
+      }
+    }
+
+    return index;
+  }
+
+  [[nodiscard]] auto balance(const index_type nodeIndex) -> index_type
+  {
+    if (m_nodes.at(nodeIndex).is_leaf() || (m_nodes.at(nodeIndex).height < 2)) {
+      return nodeIndex;
+    }
+
+    const auto leftIndex = m_nodes.at(nodeIndex).left.value();
+    const auto rightIndex = m_nodes.at(nodeIndex).right.value();
+
+    assert(leftIndex < m_nodeCapacity);
+    assert(rightIndex < m_nodeCapacity);
+
+    const auto currentBalance =
+        m_nodes.at(rightIndex).height - m_nodes.at(leftIndex).height;
+
+    // Rotate right branch up.
+    if (currentBalance > 1) {
+      rotate_right(nodeIndex, leftIndex, rightIndex);
+      return rightIndex;
+    }
+
+    // Rotate left branch up.
+    if (currentBalance < -1) {
+      rotate_left(nodeIndex, leftIndex, rightIndex);
+      return leftIndex;
+    }
+
+    return nodeIndex;
+  }
+
+  /**
+   * \brief Restructures a subtree according to the balancing strategy.
+   *
+   * \param nodeIndex the index of the root of the subtree.
+   *
+   * \return the index of the new root of the subtree.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto restructure(const index_type nodeIndex) -> index_type
+  {
+    if (m_balancing == balancing_strategy::surface_area) {
+      return rotate_for_surface_area(nodeIndex);
+    } else if (m_balancing == balancing_strategy::height) {
+      return balance(nodeIndex);
+    } else {
+      return nodeIndex;
+    }
+  }
+
+  /**
+   * \brief Returns the inefficiency of an internal node.
+   *
+   * \details This is the combined measure of Bittner et al., which favours
+   * large nodes whose area is poorly utilized by their children.
+   *
+   * \param node the internal node.
+   *
+   * \return the inefficiency of the node, higher values are worse.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto inefficiency(const node_type& node) const -> double
+  {
+    constexpr auto epsilon = std::numeric_limits<double>::min();
+
+    const auto area = cost_of(node.aabb);
+    const auto leftArea = cost_of(m_nodes.at(node.left.value()).aabb);
+    const auto rightArea = cost_of(m_nodes.at(node.right.value()).aabb);
+
+    const auto meanArea = std::max(0.5 * (leftArea + rightArea), epsilon);
+    const auto minArea = std::max(std::min(leftArea, rightArea), epsilon);
+
+    return (area / meanArea) * (area / minArea) * area;
+  }
+
+  /// The amount of node slots ranked by `optimize()` per unit of budget.
+  static constexpr size_type optimizeWindowFactor = 256;
+
+  /// The maximum amount of leaves in a treelet.
+  static constexpr size_type treeletSize = 7;
+
+  /**
+   * \struct treelet
+   *
+   * \brief A connected part of the tree that is restructured as a unit.
+   *
+   * \details The children of the internal nodes are encoded as references,
+   * where values less than `treeletSize` denote treelet leaves and other
+   * values denote the internal node at `reference - treeletSize`.
+   *
+   * \since 0.3.0
+   */
+  struct treelet final
+  {
+    /// The internal nodes, the first one is the root of the treelet.
+    std::array<index_type, treeletSize - 1> internal{};
+
+    /// The leaves, which are the roots of the subtrees below the treelet.
+    std::array<index_type, treeletSize> leaves{};
+
+    /// The optimal children of each internal node.
+    std::array<std::pair<size_type, size_type>, treeletSize - 1> children{};
+
+    size_type leafCount{0};
+    bool isImproved{false};
+  };
+
+  /**
+   * \brief Selects disjoint treelets, starting at the most expensive nodes.
+   *
+   * \param isExcluded indicates the nodes that must not be treelet roots.
+   *
+   * \return the selected treelets, which don't share any internal nodes.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto select_treelets(const std::vector<bool>& isExcluded) const
+      -> std::vector<treelet>
+  {
+    std::vector<std::pair<double, index_type>> candidates;
+    for (index_type index = 0; index < m_nodeCapacity; ++index) {
+      const auto& node = m_nodes.at(index);
+      if (node.height >= 1 && node.count >= 3 && !isExcluded.at(index)) {
+        candidates.emplace_back(cost_of(node.aabb), index);
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), std::greater<>{});
+
+    std::vector<bool> isClaimed(m_nodeCapacity, false);
+    std::vector<treelet> treelets;
+
+    for (const auto& [cost, root] : candidates) {
+      if (isClaimed.at(root)) {
+        continue;
+      }
+
+      treelet treelet;
+      treelet.internal.front() = root;
+      treelet.leaves.at(0) = m_nodes.at(root).left.value();
+      treelet.leaves.at(1) = m_nodes.at(root).right.value();
+      treelet.leafCount = 2;
+
+      while (treelet.leafCount < treeletSize) {
+        // Expands the most expensive treelet leaf that is an internal node.
+        std::optional<size_type> best;
+        for (size_type i = 0; i < treelet.leafCount; ++i) {
+          const auto index = treelet.leaves.at(i);
+          const auto& node = m_nodes.at(index);
+          if (node.is_leaf() || isClaimed.at(index)) {
+            continue;
+          }
+
+          if (!best || cost_of(node.aabb) >
+                           cost_of(m_nodes.at(treelet.leaves.at(*best)).aabb)) {
+            best = i;
+          }
+        }
+
+        if (!best) {
+          break;
+        }
+
+        const auto& node = m_nodes.at(treelet.leaves.at(*best));
+        treelet.internal.at(treelet.leafCount - 1) = treelet.leaves.at(*best);
+        treelet.leaves.at(*best) = node.left.value();
+        treelet.leaves.at(treelet.leafCount) = node.right.value();
+        ++treelet.leafCount;
+      }
+
+      if (treelet.leafCount < 3) {
+        continue;
+      }
+
+      for (size_type i = 0; i < treelet.leafCount - 1; ++i) {
+        isClaimed.at(treelet.internal.at(i)) = true;
+      }
+
+      treelets.push_back(treelet);
+    }
+
+    return treelets;
+  }
+
+  /**
+   * \brief Finds the topology of a treelet that minimizes the total cost of
+   * its internal nodes.
+   *
+   * \details Every subset of the treelet leaves is assigned the cheapest way
+   * to split it into two subsets, which is O(3^n). The tree itself is not
+   * modified, so disjoint treelets can be optimized concurrently.
+   *
+   * \param treelet the treelet, its children and improvement flag are set.
+   * \param bounds a scratch buffer, reused between invocations.
+   *
+   * \since 0.3.0
+   */
+  void optimize_treelet(treelet& treelet, std::vector<aabb_type>& bounds) const
+  {
+    constexpr auto tolerance = 1e-9;
+    constexpr auto subsetCount = size_type{1} << treeletSize;
+
+    const auto leafCount = treelet.leafCount;
+    const auto all = (size_type{1} << leafCount) - 1;
+
+    const auto leafPosition = [](const size_type subset) {
+      size_type position{0};
+      while ((subset >> position) != 1) {
+        ++position;
+      }
+      return position;
+    };
+
+    // The subset bounds are stored at the subset minus one.
+    bounds.clear();
+
+    std::array<double, subsetCount> costs{};
+    std::array<size_type, subsetCount> splits{};
+
+    for (size_type subset = 1; subset <= all; ++subset) {
+      const auto lowest = subset & (~subset + 1);
+      if (subset == lowest) {
+        const auto leaf = treelet.leaves.at(leafPosition(subset));
+        bounds.push_back(m_nodes.at(leaf).aabb);
+        continue;
+      }
+
+      const auto rest = subset ^ lowest;
+      bounds.push_back(aabb_type::merge(bounds.at(rest - 1),
+                                        bounds.at(lowest - 1)));
+
+      // Every split is visited once, with the lowest leaf on the left.
+      auto bestCost = std::numeric_limits<double>::max();
+      for (auto part = rest;; part = (part - 1) & rest) {
+        const auto left = part | lowest;
+        if (left != subset) {
+          const auto cost = costs.at(left) + costs.at(subset ^ left);
+          if (cost < bestCost) {
+            bestCost = cost;
+            splits.at(subset) = left;
+          }
+        }
+
+        if (part == 0) {
+          break;
+        }
+      }
+
+      costs.at(subset) = cost_of(bounds.back()) + bestCost;
+    }
+
+    auto currentCost = 0.0;
+    for (size_type i = 0; i < leafCount - 1; ++i) {
+      currentCost += cost_of(m_nodes.at(treelet.internal.at(i)).aabb);
+    }
+
+    treelet.isImproved = costs.at(all) < (1.0 - tolerance) * currentCost;
+    if (!treelet.isImproved) {
+      return;
+    }
+
+    // Emits the internal nodes in pre-order, so children follow parents.
+    std::array<std::pair<size_type, size_type>, treeletSize - 1> stack{};
+    size_type stackSize{0};
+    size_type nextSlot{1};
+
+    stack.at(stackSize++) = {all, 0};
+    while (stackSize != 0) {
+      const auto [subset, slot] = stack.at(--stackSize);
+
+      const auto reference = [&](const size_type child) {
+        if ((child & (child - 1)) == 0) {
+          return leafPosition(child);
+        } else {
+          stack.at(stackSize++) = {child, nextSlot};
+          return treeletSize + nextSlot++;
+        }
+      };
+
+      const auto left = splits.at(subset);
+      const auto fst = reference(left);
+      const auto snd = reference(subset ^ left);
+      treelet.children.at(slot) = {fst, snd};
+    }
+  }
+
+  /**
+   * \brief Restructures the tree according to an optimized treelet.
+   *
+   * \details The AABB of the treelet root is unaffected, but the heights of
+   * its ancestors are updated.
+   *
+   * \param treelet the optimized treelet.
+   *
+   * \since 0.3.0
+   */
+  void apply_treelet(const treelet& treelet)
+  {
+    const auto resolve = [&](const size_type reference) {
+      if (reference < treeletSize) {
+        return treelet.leaves.at(reference);
+      } else {
+        return treelet.internal.at(reference - treeletSize);
+      }
+    };
+
+    // Children have higher slots than their parents.
+    for (auto slot = treelet.leafCount - 1; slot-- > 0;) {
+      const auto index = treelet.internal.at(slot);
+      const auto [fst, snd] = treelet.children.at(slot);
+
+      auto& node = m_nodes.at(index);
+      node.left = resolve(fst);
+      node.right = resolve(snd);
+
+      m_nodes.at(*node.left).parent = index;
+      m_nodes.at(*node.right).parent = index;
+
+      refit_node(index);
+    }
+
+    auto parent = m_nodes.at(treelet.internal.front()).parent;
+    while (parent != std::nullopt) {
+      auto& node = m_nodes.at(*parent);
+      node.height = 1 + std::max(m_nodes.at(node.left.value()).height,
+                                 m_nodes.at(node.right.value()).height);
+      parent = node.parent;
+    }
+  }
+
+  /**
+   * \brief Performs the rotation that reduces the surface area of the subtree
+   * the most, if any.
+   *
+   * \details A rotation swaps one of the children of the node with one of the
+   * children of its sibling, as described by Kensler in "Tree Rotations for
+   * Improving Bounding Volume Hierarchies". The AABB of the node itself is not
+   * affected, only the AABB of the child that receives a new child changes.
+   *
+   * \pre The children and grandchildren of the node must be up-to-date.
+   *
+   * \param nodeIndex the index of the node.
+   *
+   * \return the index of the node, which remains the root of the subtree.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto rotate_for_surface_area(const index_type nodeIndex)
+      -> index_type
+  {
+    const auto& node = m_nodes.at(nodeIndex);
+    if (node.is_leaf()) {
+      return nodeIndex;
+    }
+
+    struct rotation final
+    {
+      index_type child;       ///< The child that moves down.
+      index_type grandchild;  ///< The grandchild that moves up.
+      double delta;           ///< The change in surface area.
+    };
+
+    std::optional<rotation> best;
+
+    // Considers swapping a child with each of the children of its sibling.
+    const auto consider = [&](const index_type child, const index_type other) {
+      const auto& otherNode = m_nodes.at(other);
+      if (otherNode.is_leaf()) {
+        return;
+      }
+
+      const auto& childAabb = m_nodes.at(child).aabb;
+      const auto left = otherNode.left.value();
+      const auto right = otherNode.right.value();
+      const auto area = cost_of(otherNode.aabb);
+
+      const auto leftDelta =
+          cost_of(aabb_type::merge(childAabb, m_nodes.at(right).aabb)) - area;
+      if (leftDelta < (best ? best->delta : 0)) {
+        best = rotation{child, left, leftDelta};
+      }
+
+      const auto rightDelta =
+          cost_of(aabb_type::merge(childAabb, m_nodes.at(left).aabb)) - area;
+      if (rightDelta < (best ? best->delta : 0)) {
+        best = rotation{child, right, rightDelta};
+      }
+    };
+
+    consider(node.left.value(), node.right.value());
+    consider(node.right.value(), node.left.value());
+
+    if (!best) {
+      return nodeIndex;
+    }
+
+    const auto child = best->child;
+    const auto grandchild = best->grandchild;
+    const auto otherIndex = m_nodes.at(grandchild).parent.value();
+
+    auto& parent = m_nodes.at(nodeIndex);
+    if (parent.left == child) {
+      parent.left = grandchild;
+    } else {
+      parent.right = grandchild;
+    }
+
+    auto& other = m_nodes.at(otherIndex);
+    if (other.left == grandchild) {
+      other.left = child;
+    } else {
+      other.right = child;
+    }
+
+    m_nodes.at(child).parent = otherIndex;
+    m_nodes.at(grandchild).parent = nodeIndex;
+
+    refit_node(otherIndex);
+
+    return nodeIndex;
+  }
+
+  void fix_tree_upwards(maybe_index index)
+  {
+    while (index != std::nullopt) {
+      index = restructure(*index);
+
+      auto& node = m_nodes.at(*index);
+
+      const auto left = node.left.value();
+      const auto right = node.right.value();
+
+      const auto& leftNode = m_nodes.at(left);
+      const auto& rightNode = m_nodes.at(right);
+
+      node.height = 1 + std::max(leftNode.height, rightNode.height);
+      set_aabb(node, aabb_type::merge(leftNode.aabb, rightNode.aabb));
+      update_augmentations(node, leftNode, rightNode);
+
+      index = node.parent;
+    }
+  }
+
+  void insert_leaf(const index_type leafIndex)
+  {
+    if (m_root == std::nullopt) {
+      m_root = leafIndex;
+      m_nodes.at(*m_root).parent = std::nullopt;
+      return;
+    }
+
+    insert_leaf(leafIndex, find_sibling(m_nodes.at(leafIndex).aabb));
+  }
+
+  /**
+   * \brief Returns the best sibling for a new node, according to the insertion
+   * strategy.
+   *
+   * \pre The tree must not be empty.
+   *
+   * \param aabb the AABB of the node that will be inserted.
+   *
+   * \return the index of the best sibling.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto find_sibling(const aabb_type& aabb) const -> index_type
+  {
+    if (m_insertion == insertion_strategy::branch_and_bound) {
+      return find_best_sibling_branch_and_bound(aabb);
+    } else {
+      return find_best_sibling(aabb);
+    }
+  }
+
+  /**
+   * \brief Inserts a detached node into the tree, next to the specified
+   * sibling.
+   *
+   * \param leafIndex the index of the detached node, which may be the root
+   * of a subtree.
+   * \param siblingIndex the index of the node that will become the sibling of
+   * the inserted node.
+   *
+   * \since 0.3.0
+   */
+  void insert_leaf(const index_type leafIndex, const index_type siblingIndex)
+  {
+    // Walk back up the tree fixing heights and AABBs.
+    fix_tree_upwards(link_leaf(leafIndex, siblingIndex));
+  }
+
+  /**
+   * \brief Attaches a detached node next to the specified sibling, without
+   * updating the ancestors of the new parent.
+   *
+   * \param leafIndex the index of the detached node.
+   * \param siblingIndex the index of the node that will become the sibling of
+   * the attached node.
+   *
+   * \return the index of the new parent of the two nodes.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto link_leaf(const index_type leafIndex,
+                               const index_type siblingIndex) -> index_type
+  {
+    const auto leafAabb = m_nodes.at(leafIndex).aabb;  // copy current AABB
+
+    // Create a new parent.
+    const auto oldParentIndex = m_nodes.at(siblingIndex).parent;
+    const auto newParentIndex = allocate_node();
+
+    auto& newParent = m_nodes.at(newParentIndex);
+    newParent.parent = oldParentIndex;
+    set_aabb(newParent,
+             aabb_type::merge(leafAabb, m_nodes.at(siblingIndex).aabb));
+    // m_nodes[newParent].aabb.merge(leafAABB, m_nodes[sibling].aabb);
+    newParent.height = 1 + std::max(m_nodes.at(leafIndex).height,
+                                    m_nodes.at(siblingIndex).height);
+    update_augmentations(
+        newParent, m_nodes.at(leafIndex), m_nodes.at(siblingIndex));
+
+    if (oldParentIndex != std::nullopt) {  // The sibling was not the root.
+      auto& oldParent = m_nodes.at(*oldParentIndex);
+      if (oldParent.left == siblingIndex) {
+        oldParent.left = newParentIndex;
+      } else {
+        oldParent.right = newParentIndex;
+      }
+    } else {  // The sibling was the root.
+      m_root = newParentIndex;
+    }
+
+    newParent.left = siblingIndex;
+    newParent.right = leafIndex;
+
+    m_nodes.at(siblingIndex).parent = newParentIndex;
+    m_nodes.at(leafIndex).parent = newParentIndex;
+
+    return newParentIndex;
+  }
+
+  void adjust_ancestor_bounds(maybe_index index)
+  {
+    while (index != std::nullopt) {
+      index = restructure(*index);
+
+      auto& node = m_nodes.at(*index);
+
+      const auto left = node.left;
+      const auto right = node.right;
+      const auto& leftNode = m_nodes.at(left.value());
+      const auto& rightNode = m_nodes.at(right.value());
+
+      set_aabb(node, aabb_type::merge(leftNode.aabb, rightNode.aabb));
+      node.height = 1 + std::max(leftNode.height, rightNode.height);
+      update_augmentations(node, leftNode, rightNode);
+
+      index = node.parent;
+    }
+  }
+
+  void remove_leaf(const index_type leafIndex)
+  {
+    // Adjust ancestor bounds.
+    adjust_ancestor_bounds(unlink_leaf(leafIndex));
+  }
+
+  /**
+   * \brief Detaches a leaf from the tree and frees its parent, without
+   * updating the remaining ancestors.
+   *
+   * \details The node may also be an internal node, in which case the entire
+   * subtree rooted at it is detached.
+   *
+   * \param leafIndex the index of the leaf, or the root of a subtree.
+   *
+   * \return the index of the former grandparent of the leaf, which is the
+   * first node with an outdated AABB, if any.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto unlink_leaf(const index_type leafIndex) -> maybe_index
+  {
+    if (leafIndex == m_root) {
+      m_root = std::nullopt;
+      return std::nullopt;
+    }
+
+    const auto parentIndex = m_nodes.at(leafIndex).parent;
+    const auto grandParentIndex = m_nodes.at(parentIndex.value()).parent;
+
+    const auto siblingIndex =
+        (m_nodes.at(parentIndex.value()).left == leafIndex)
+            ? m_nodes.at(parentIndex.value()).right
+            : m_nodes.at(parentIndex.value()).left;
+
+    // Destroy the parent and connect the sibling to the grandparent.
+    if (grandParentIndex != std::nullopt) {
+      if (m_nodes.at(*grandParentIndex).left == parentIndex) {
+        m_nodes.at(*grandParentIndex).left = siblingIndex;
+      } else {
+        m_nodes.at(*grandParentIndex).right = siblingIndex;
+      }
+
+      m_nodes.at(siblingIndex.value()).parent = grandParentIndex;
+      free_node(parentIndex.value());
+    } else {
+      m_root = siblingIndex;
+      m_nodes.at(siblingIndex.value()).parent = std::nullopt;
+      free_node(parentIndex.value());
+    }
+
+    return grandParentIndex;
+  }
+
+  void rotate_right(const index_type nodeIndex,
+                    const index_type leftIndex,
+                    const index_type rightIndex)
+  {
+    auto& node = m_nodes.at(nodeIndex);
+    auto& rightNode = m_nodes.at(rightIndex);
+
+    const auto rightLeft = rightNode.left.value();
+    const auto rightRight = rightNode.right.value();
+
+    assert(rightLeft < m_nodeCapacity);
+    assert(rightRight < m_nodeCapacity);
+
+    // Swap node and its right-hand child.
+    rightNode.left = nodeIndex;
+    rightNode.parent = node.parent;
+    node.parent = rightIndex;
+
+    // The node's old parent should now point to its right-hand child.
+    if (rightNode.parent != std::nullopt) {
+      auto& rightParent = m_nodes.at(*rightNode.parent);
+      if (rightParent.left == nodeIndex) {
+        rightParent.left = rightIndex;
+      } else {
+        assert(rightParent.right == nodeIndex);
+        rightParent.right = rightIndex;
+      }
+    } else {
+      m_root = rightIndex;
+    }
+
+    auto& leftNode = m_nodes.at(leftIndex);
+    auto& rightRightNode = m_nodes.at(rightRight);
+    auto& rightLeftNode = m_nodes.at(rightLeft);
+
+    // Rotate.
+    if (rightLeftNode.height > rightRightNode.height) {
+      rightNode.right = rightLeft;
+      node.right = rightRight;
+
+      rightRightNode.parent = nodeIndex;
+
+      set_aabb(node, aabb_type::merge(leftNode.aabb, rightRightNode.aabb));
+      set_aabb(rightNode, aabb_type::merge(node.aabb, rightLeftNode.aabb));
+
+      node.height = 1 + std::max(leftNode.height, rightRightNode.height);
+      rightNode.height = 1 + std::max(node.height, rightLeftNode.height);
+
+      update_augmentations(node, leftNode, rightRightNode);
+      update_augmentations(rightNode, node, rightLeftNode);
+    } else {
+      rightNode.right = rightRight;
+      node.right = rightLeft;
+
+      rightLeftNode.parent = nodeIndex;
+
+      set_aabb(node, aabb_type::merge(leftNode.aabb, rightLeftNode.aabb));
+      set_aabb(rightNode, aabb_type::merge(node.aabb, rightRightNode.aabb));
+
+      node.height = 1 + std::max(leftNode.height, rightLeftNode.height);
+      rightNode.height = 1 + std::max(node.height, rightRightNode.height);
+
+      update_augmentations(node, leftNode, rightLeftNode);
+      update_augmentations(rightNode, node, rightRightNode);
+    }
+  }
+
+  void rotate_left(const index_type nodeIndex,
+                   const index_type leftIndex,
+                   const index_type rightIndex)
+  {
+    auto& node = m_nodes.at(nodeIndex);
+    auto& leftNode = m_nodes.at(leftIndex);
+
+    const auto leftLeft = leftNode.left.value();
+    const auto leftRight = leftNode.right.value();
+
+    assert(leftLeft < m_nodeCapacity);
+    assert(leftRight < m_nodeCapacity);
+
+    // Swap node and its left-hand child.
+    leftNode.left = nodeIndex;
+    leftNode.parent = node.parent;
+    node.parent = leftIndex;
+
+    // The node's old parent should now point to its left-hand child.
+    if (leftNode.parent != std::nullopt) {
+      auto& leftParent = m_nodes.at(*leftNode.parent);
+      if (leftParent.left == nodeIndex) {
+        leftParent.left = leftIndex;
+      } else {
+        assert(leftParent.right == nodeIndex);
+        leftParent.right = leftIndex;
+      }
+    } else {
+      m_root = leftIndex;
+    }
+
+    auto& rightNode = m_nodes.at(rightIndex);
+    auto& leftLeftNode = m_nodes.at(leftLeft);
+    auto& leftRightNode = m_nodes.at(leftRight);
+
+    // Rotate.
+    if (leftLeftNode.height > leftRightNode.height) {
+      leftNode.right = leftLeft;
+      node.left = leftRight;
+
+      leftRightNode.parent = nodeIndex;
+
+      set_aabb(node, aabb_type::merge(rightNode.aabb, leftRightNode.aabb));
+      set_aabb(leftNode, aabb_type::merge(node.aabb, leftLeftNode.aabb));
+
+      node.height = 1 + std::max(rightNode.height, leftRightNode.height);
+      leftNode.height = 1 + std::max(node.height, leftLeftNode.height);
+
+      update_augmentations(node, rightNode, leftRightNode);
+      update_augmentations(leftNode, node, leftLeftNode);
+    } else {
       leftNode.right = leftRight;
       node.left = leftLeft;
 
-      leftLeftNode.parent = nodeIndex;
+      leftLeftNode.parent = nodeIndex;
+
+      set_aabb(node, aabb_type::merge(rightNode.aabb, leftLeftNode.aabb));
+      set_aabb(leftNode, aabb_type::merge(node.aabb, leftRightNode.aabb));
+
+      node.height = 1 + std::max(rightNode.height, leftLeftNode.height);
+      leftNode.height = 1 + std::max(node.height, leftRightNode.height);
+
+      update_augmentations(node, rightNode, leftLeftNode);
+      update_augmentations(leftNode, node, leftRightNode);
+    }
+  }
+
+  [[nodiscard]] auto compute_height() const -> size_type
+  {
+    return compute_height(m_root);
+  }
+
+  [[nodiscard]] auto compute_height(const maybe_index nodeIndex) const
+      -> size_type
+  {
+    if (!nodeIndex) {
+      return 0;
+    }
+
+    assert(nodeIndex < m_nodeCapacity);
+
+    const auto& node = m_nodes.at(*nodeIndex);
+    if (node.is_leaf()) {
+      return 0;
+    } else {
+      const auto left = compute_height(node.left);
+      const auto right = compute_height(node.right);
+      return 1 + std::max(left, right);
+    }
+  }
+
+  void validate() const
+  {
+#ifndef NDEBUG
+    validate_structure(m_root);
+    validate_metrics(m_root);
+
+    auto freeCount = 0;
+    auto freeIndex = m_nextFreeIndex;
+
+    while (freeIndex != std::nullopt) {
+      assert(freeIndex < m_nodeCapacity);
+      freeIndex = m_nodes[*freeIndex].next;
+      freeCount++;
+    }
+
+    assert(height() == compute_height());
+    assert((m_nodeCount + freeCount) == m_nodeCapacity);
+
+    const auto totalArea = compute_total_area();
+    assert(std::abs(m_totalArea - totalArea) <=
+           1e-6 * std::max(1.0, totalArea));
+#endif
+  }
+
+  void validate_structure(const maybe_index nodeIndex) const
+  {
+    if (nodeIndex == std::nullopt) {
+      return;
+    }
+
+    const auto& node = m_nodes.at(*nodeIndex);
+
+    if (nodeIndex == m_root) {
+      assert(node.parent == std::nullopt);
+    }
+
+    const auto left = node.left;
+    const auto right = node.right;
+
+    if (node.is_leaf()) {
+      assert(left == std::nullopt);
+      assert(right == std::nullopt);
+      assert(node.height == 0);
+    } else {
+      assert(left < m_nodeCapacity);
+      assert(right < m_nodeCapacity);
+      assert(left != std::nullopt);
+      assert(right != std::nullopt);
+
+      assert(m_nodes.at(*left).parent == nodeIndex);
+      assert(m_nodes.at(*right).parent == nodeIndex);
+
+      validate_structure(left);
+      validate_structure(right);
+    }
+  }
+
+  void validate_metrics(const maybe_index nodeIndex) const
+  {
+    if (nodeIndex == std::nullopt) {
+      return;
+    }
+
+    const auto& node = m_nodes.at(*nodeIndex);
+    const auto left = node.left;
+    const auto right = node.right;
+
+    if (node.is_leaf()) {
+      assert(left == std::nullopt);
+      assert(right == std::nullopt);
+      assert(node.height == 0);
+      return;
+    } else {
+      assert(left < m_nodeCapacity);
+      assert(right < m_nodeCapacity);
+      assert(left != std::nullopt);
+      assert(right != std::nullopt);
+
+      const auto leftHeight = m_nodes.at(*left).height;
+      const auto rightHeight = m_nodes.at(*right).height;
+      const auto height = 1 + std::max(leftHeight, rightHeight);
+      assert(node.height == height);
+
+      const auto aabb =
+          aabb_type::merge(m_nodes.at(*left).aabb, m_nodes.at(*right).aabb);
+
+      for (auto i = 0; i < 2; ++i) {
+        assert(aabb.min()[i] == node.aabb.min()[i]);
+        assert(aabb.max()[i] == node.aabb.max()[i]);
+      }
+
+      assert(node.categories == (m_nodes.at(*left).categories |
+                                 m_nodes.at(*right).categories));
+      assert(node.count == m_nodes.at(*left).count + m_nodes.at(*right).count);
+
+      if constexpr (std::is_arithmetic_v<aggregate_value>) {
+        assert(node.value == aggregate_type::combine(m_nodes.at(*left).value,
+                                                     m_nodes.at(*right).value));
+      }
+
+      validate_metrics(left);
+      validate_metrics(right);
+    }
+  }
+};
+
+/**
+ * \class pair_manager
+ *
+ * \brief A broadphase that keeps track of overlapping pairs of AABBs.
+ *
+ * \details The pair manager wraps an AABB tree and remembers the keys of the
+ * entries that were actually reinserted into the tree since the last call to
+ * `update_pairs()`. Only these "moved" entries are queried when the pairs are
+ * updated, which means that the cost of updating the pairs is proportional to
+ * the amount of moved entries rather than the total amount of entries, as long
+ * as most entries stay within their fattened AABBs.
+ *
+ * \tparam Key the type of the keys associated with each AABB. Must be hashable.
+ * \tparam T the representation type used by the AABBs.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+template <typename Key, typename T = double>
+class pair_manager final
+{
+ public:
+  using tree_type = tree<Key, T>;
+  using value_type = typename tree_type::value_type;
+  using key_type = typename tree_type::key_type;
+  using vector_type = typename tree_type::vector_type;
+  using aabb_type = typename tree_type::aabb_type;
+  using size_type = typename tree_type::size_type;
+
+  /**
+   * \brief Creates a pair manager.
+   *
+   * \param capacity the initial node capacity of the underlying tree.
+   *
+   * \since 0.3.0
+   */
+  explicit pair_manager(const size_type capacity = 16) : m_tree{capacity}
+  {}
+
+  /**
+   * \brief Inserts an AABB.
+   *
+   * \details The pairs of the new AABB are reported by the next call to
+   * `update_pairs()`.
+   *
+   * \pre `key` cannot be in use at the time of invoking this function.
+   *
+   * \param key the ID that will be associated with the box.
+   * \param lowerBound the lower-bound position of the AABB.
+   * \param upperBound the upper-bound position of the AABB.
+   *
+   * \since 0.3.0
+   */
+  void insert(const key_type& key,
+              const vector_type& lowerBound,
+              const vector_type& upperBound)
+  {
+    m_tree.insert(key, lowerBound, upperBound);
+    m_moved.push_back(key);
+  }
+
+  /**
+   * \brief Removes the AABB associated with the specified ID.
+   *
+   * \details The pairs of the removed AABB are reported as ended by the next
+   * call to `update_pairs()`.
+   *
+   * \note This function has no effect if there is no AABB associated with the
+   * specified ID.
+   *
+   * \param key the ID associated with the AABB that will be removed.
+   *
+   * \since 0.3.0
+   */
+  void erase(const key_type& key)
+  {
+    if (const auto it = m_pairs.find(key); it != m_pairs.end()) {
+      for (const auto& other : it->second) {
+        unlink(other, key);
+        m_ended.emplace_back(key, other);
+      }
+      m_pairs.erase(it);
+    }
+
+    m_tree.erase(key);
+  }
+
+  /**
+   * \brief Updates the AABB associated with the specified ID.
+   *
+   * \details The entry is only considered to have moved if it was reinserted
+   * into the tree, i.e. if the new AABB isn't contained in the fattened AABB.
+   *
+   * \param key the ID associated with the AABB that will be replaced.
+   * \param aabb the new AABB that will be associated with the specified ID.
+   * \param forceReinsert indicates whether or not the AABB is always
+   * reinserted.
+   *
+   * \return `true` if the entry was reinserted; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto update(const key_type& key,
+              const aabb_type& aabb,
+              bool forceReinsert = false) -> bool
+  {
+    if (m_tree.update(key, aabb, forceReinsert)) {
+      m_moved.push_back(key);
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  auto update(const key_type& key,
+              const vector_type& lowerBound,
+              const vector_type& upperBound,
+              bool forceReinsert = false) -> bool
+  {
+    return update(key, {lowerBound, upperBound}, forceReinsert);
+  }
+
+  /**
+   * \brief Updates the position of the AABB associated with the specified ID.
+   *
+   * \param key the ID associated with the AABB that will be moved.
+   * \param position the new position of the AABB.
+   * \param forceReinsert `true` if the associated AABB is forced to be
+   * reinserted into the tree.
+   *
+   * \return `true` if the entry was reinserted; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto relocate(const key_type& key,
+                const vector_type& position,
+                bool forceReinsert = false) -> bool
+  {
+    if (m_tree.relocate(key, position, forceReinsert)) {
+      m_moved.push_back(key);
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  /**
+   * \brief Updates the persistent set of overlapping pairs.
+   *
+   * \details Only the entries that moved since the last invocation are
+   * queried. Pairs that stopped overlapping, including the pairs of erased
+   * entries, are reported before the pairs that started overlapping.
+   *
+   * \tparam BeginVisitor the type of the begin visitor, must be invocable with
+   * two `const key_type&` arguments.
+   * \tparam EndVisitor the type of the end visitor, must be invocable with two
+   * `const key_type&` arguments.
+   *
+   * \param onBegin invoked for each pair that started overlapping.
+   * \param onEnd invoked for each pair that stopped overlapping.
+   *
+   * \since 0.3.0
+   */
+  template <typename BeginVisitor, typename EndVisitor>
+  void update_pairs(BeginVisitor&& onBegin, EndVisitor&& onEnd)
+  {
+    for (const auto& [fst, snd] : m_ended) {
+      onEnd(fst, snd);
+    }
+    m_ended.clear();
+
+    for (const auto& key : m_moved) {
+      if (!m_tree.contains(key)) {  // Erased after it moved
+        continue;
+      }
+
+      const auto& aabb = m_tree.get_aabb(key);
+      auto& pairs = m_pairs[key];
+
+      // A pair can only stop overlapping if at least one of its entries moved.
+      for (auto it = pairs.begin(); it != pairs.end();) {
+        const auto& other = *it;
+        if (aabb.overlaps(m_tree.get_aabb(other), true)) {
+          ++it;
+        } else {
+          onEnd(key, other);
+          unlink(other, key);
+          it = pairs.erase(it);
+        }
+      }
+
+      m_candidates.clear();
+      m_tree.query(key, std::back_inserter(m_candidates));
+
+      for (const auto& candidate : m_candidates) {
+        if (pairs.insert(candidate).second) {
+          m_pairs[candidate].insert(key);
+          onBegin(key, candidate);
+        }
+      }
+
+      if (pairs.empty()) {
+        m_pairs.erase(key);
+      }
+    }
+
+    m_moved.clear();
+  }
+
+  /**
+   * \brief Indicates whether or not two entries are in an overlapping pair.
+   *
+   * \note The result reflects the state after the last call to
+   * `update_pairs()`.
+   *
+   * \param fst the key of the first entry.
+   * \param snd the key of the second entry.
+   *
+   * \return `true` if the entries are paired; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto is_paired(const key_type& fst, const key_type& snd) const
+      -> bool
+  {
+    if (const auto it = m_pairs.find(fst); it != m_pairs.end()) {
+      return it->second.count(snd);
+    } else {
+      return false;
+    }
+  }
+
+  /**
+   * \brief Returns the amount of overlapping pairs.
+   *
+   * \return the amount of pairs after the last call to `update_pairs()`.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto pair_count() const noexcept -> size_type
+  {
+    size_type count{0};
+    for (const auto& [key, pairs] : m_pairs) {
+      count += pairs.size();
+    }
+    return count / 2;
+  }
+
+  /**
+   * \brief Returns the amount of entries that moved since the last update.
+   *
+   * \return the amount of entries that will be queried by `update_pairs()`.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto moved_count() const noexcept -> size_type
+  {
+    return m_moved.size();
+  }
+
+  /**
+   * \brief Returns the underlying AABB tree.
+   *
+   * \return the tree used by the pair manager.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_tree() const noexcept -> const tree_type&
+  {
+    return m_tree;
+  }
 
-      node.aabb = aabb_type::merge(rightNode.aabb, leftLeftNode.aabb);
-      leftNode.aabb = aabb_type::merge(node.aabb, leftRightNode.aabb);
+ private:
+  tree_type m_tree;
+  std::vector<key_type> m_moved;
+  std::vector<key_type> m_candidates;
+  std::vector<std::pair<key_type, key_type>> m_ended;
+  std::unordered_map<key_type, std::unordered_set<key_type>> m_pairs;
 
-      node.height = 1 + std::max(rightNode.height, leftLeftNode.height);
-      leftNode.height = 1 + std::max(node.height, leftRightNode.height);
+  void unlink(const key_type& key, const key_type& other)
+  {
+    if (const auto it = m_pairs.find(key); it != m_pairs.end()) {
+      it->second.erase(other);
+      if (it->second.empty()) {
+        m_pairs.erase(it);
+      }
     }
   }
+};
 
-  [[nodiscard]] auto compute_height() const -> size_type
+/**
+ * \class async_tree
+ *
+ * \brief An AABB tree that can be rebuilt on a worker thread.
+ *
+ * \details A rebuild snapshots the node pool and builds a fresh tree from its
+ * leaves on a worker thread, whilst the current tree remains in use. The
+ * latest state of the entries that are modified in the meantime is recorded.
+ * Once the fresh tree is built, the recorded changes are replayed in it on the
+ * worker thread, until few enough of them remain to be replayed when the
+ * fresh tree is swapped in, which should be done at a frame boundary. The
+ * previous tree is kept as a back buffer for the next rebuild, so that its
+ * memory is reused, and so that it is never destroyed on the calling thread.
+ *
+ * \note The snapshots only include the keys and AABBs, so collision
+ * categories and aggregate values aren't supported.
+ *
+ * \tparam Key the type of the keys associated with each AABB. Must be hashable.
+ * \tparam T the representation type used by the AABBs.
+ *
+ * \since 0.3.0
+ *
+ * \headerfile abby.hpp
+ */
+template <typename Key, typename T = double>
+class async_tree final
+{
+ public:
+  using tree_type = tree<Key, T>;
+  using value_type = typename tree_type::value_type;
+  using key_type = typename tree_type::key_type;
+  using vector_type = typename tree_type::vector_type;
+  using aabb_type = typename tree_type::aabb_type;
+  using size_type = typename tree_type::size_type;
+
+  /**
+   * \brief Creates an asynchronously rebuildable tree.
+   *
+   * \param capacity the initial node capacity of the underlying tree.
+   *
+   * \since 0.3.0
+   */
+  explicit async_tree(const size_type capacity = 16) : m_tree{capacity}
+  {}
+
+  /**
+   * \brief Inserts an AABB.
+   *
+   * \pre `key` cannot be in use at the time of invoking this function.
+   *
+   * \param key the ID that will be associated with the box.
+   * \param lowerBound the lower-bound position of the AABB.
+   * \param upperBound the upper-bound position of the AABB.
+   *
+   * \since 0.3.0
+   */
+  void insert(const key_type& key,
+              const vector_type& lowerBound,
+              const vector_type& upperBound)
   {
-    return compute_height(m_root);
+    m_tree.insert(key, lowerBound, upperBound);
+    mark_dirty(key);
   }
 
-  [[nodiscard]] auto compute_height(const maybe_index nodeIndex) const
-      -> size_type
+  /**
+   * \brief Removes the AABB associated with the specified ID.
+   *
+   * \param key the ID associated with the AABB that will be removed.
+   *
+   * \since 0.3.0
+   */
+  void erase(const key_type& key)
   {
-    if (!nodeIndex) {
-      return 0;
+    m_tree.erase(key);
+    mark_dirty(key);
+  }
+
+  /**
+   * \brief Updates the AABB associated with the specified ID.
+   *
+   * \param key the ID associated with the AABB that will be replaced.
+   * \param aabb the new AABB that will be associated with the specified ID.
+   * \param forceReinsert indicates whether or not the AABB is always
+   * reinserted.
+   *
+   * \return `true` if the entry was reinserted; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto update(const key_type& key,
+              const aabb_type& aabb,
+              const bool forceReinsert = false) -> bool
+  {
+    const auto updated = m_tree.update(key, aabb, forceReinsert);
+    if (updated) {
+      mark_dirty(key);
     }
+    return updated;
+  }
 
-    assert(nodeIndex < m_nodeCapacity);
+  /**
+   * \brief Updates the position of the AABB associated with the specified ID.
+   *
+   * \param key the ID associated with the AABB that will be moved.
+   * \param position the new position of the AABB.
+   * \param forceReinsert `true` if the associated AABB is forced to be
+   * reinserted into the tree.
+   *
+   * \return `true` if the entry was reinserted; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto relocate(const key_type& key,
+                const vector_type& position,
+                const bool forceReinsert = false) -> bool
+  {
+    const auto updated = m_tree.relocate(key, position, forceReinsert);
+    if (updated) {
+      mark_dirty(key);
+    }
+    return updated;
+  }
 
-    const auto& node = m_nodes.at(*nodeIndex);
-    if (node.is_leaf()) {
-      return 0;
+  /**
+   * \brief Starts rebuilding the tree on a worker thread.
+   *
+   * \details The only work done on the calling thread is the snapshot, which
+   * is a bulk copy of the node pool into a buffer that is reused by every
+   * rebuild. The leaves are collected from the snapshot by the worker thread.
+   * The first rebuild, and the first one after the node pool has grown,
+   * collect the entries on the calling thread instead, whilst the worker
+   * thread allocates the buffer. The fresh tree is built with the LBVH
+   * builder, and then rebuilt with the specified strategy if it differs.
+   * This function has no effect if a rebuild is already in progress.
+   *
+   * \param strategy the algorithm that will be used to build the fresh tree.
+   * \param threadCount the maximum amount of threads used by the builder.
+   *
+   * \return `true` if a rebuild was started; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto rebuild_async(const rebuild_strategy strategy = rebuild_strategy::lbvh,
+                     const size_type threadCount = 1) -> bool
+  {
+    if (is_rebuilding()) {
+      return false;
+    }
+
+    rebuild_state state;
+    state.tree = m_back ? std::move(m_back) : std::make_unique<tree_type>();
+    state.snapshot = std::move(m_snapshot);
+
+    const auto& nodes = m_tree.m_nodes;
+    const auto nodeCount = nodes.size();
+    const auto isCopied = state.snapshot.capacity() >= nodeCount;
+
+    std::vector<std::pair<key_type, aabb_type>> entries;
+    if (isCopied) {
+      state.snapshot.assign(nodes.begin(), nodes.end());
     } else {
-      const auto left = compute_height(node.left);
-      const auto right = compute_height(node.right);
-      return 1 + std::max(left, right);
+      entries.reserve(m_tree.size());
+      m_tree.collect_entries(std::back_inserter(entries));
     }
+
+    const auto thicknessFactor = m_tree.thickness_factor();
+    const auto balancing = m_tree.get_balancing_strategy();
+    const auto insertion = m_tree.get_insertion_strategy();
+
+    m_dirty.clear();
+    m_catchUpRounds = 0;
+    m_pending = std::async(
+        std::launch::async,
+        [=, entries = std::move(entries), state = std::move(state)]() mutable {
+          if (isCopied) {
+            // At most half of the allocated nodes (rounded up) are leaves
+            entries.reserve(nodeCount / 2 + 1);
+            for (const auto& node : state.snapshot) {
+              if (node.height == 0 && node.id) {  // Allocated leaf node.
+                entries.emplace_back(*node.id, node.aabb);
+              }
+            }
+          } else {
+            // Touch the buffer here rather than in the next snapshot
+            state.snapshot = std::vector<node_type>(nodeCount);
+          }
+
+          auto& fresh = *state.tree;
+
+          // The snapshot AABBs are already fattened
+          fresh.set_thickness_factor(std::nullopt);
+          fresh.build(entries.begin(), entries.end(), threadCount);
+
+          if (strategy != rebuild_strategy::lbvh) {
+            fresh.rebuild(strategy, threadCount);
+          }
+
+          fresh.set_thickness_factor(thicknessFactor);
+          fresh.set_balancing_strategy(balancing);
+          fresh.set_insertion_strategy(insertion);
+
+          return std::move(state);
+        });
+
+    return true;
   }
 
-  void validate() const
+  /**
+   * \brief Swaps in the rebuilt tree, if the rebuild has finished.
+   *
+   * \details If more entries have been modified since the last replay than
+   * the specified limit, they are replayed in the rebuilt tree on the worker
+   * thread, and the swap is attempted again by a later call. Otherwise, the
+   * remaining entries are replayed in the rebuilt tree before it replaces the
+   * current tree, which becomes the back buffer for the next rebuild. The
+   * limit is ignored after a few replays on the worker thread, so that
+   * heavily modified trees are still swapped in eventually. This should be
+   * called at a frame boundary, e.g. once per frame.
+   *
+   * \param maxReplayCount the maximum amount of entries that are replayed on
+   * the calling thread.
+   *
+   * \return `true` if the rebuilt tree was swapped in; `false` otherwise.
+   *
+   * \since 0.3.0
+   */
+  auto swap_if_ready(const size_type maxReplayCount = 1'024) -> bool
   {
-#ifndef NDEBUG
-    validate_structure(m_root);
-    validate_metrics(m_root);
+    if (!is_rebuilding() || m_pending.wait_for(std::chrono::seconds{0}) !=
+                                std::future_status::ready) {
+      return false;
+    }
 
-    auto freeCount = 0;
-    auto freeIndex = m_nextFreeIndex;
+    auto state = m_pending.get();
 
-    while (freeIndex != std::nullopt) {
-      assert(freeIndex < m_nodeCapacity);
-      freeIndex = m_nodes[*freeIndex].next;
-      freeCount++;
+    if (m_dirty.size() > maxReplayCount && m_catchUpRounds < maxCatchUpRounds) {
+      catch_up(std::move(state));
+      return false;
     }
 
-    assert(height() == compute_height());
-    assert((m_nodeCount + freeCount) == m_nodeCapacity);
-#endif
+    swap_in(std::move(state));
+    return true;
   }
 
-  void validate_structure(const maybe_index nodeIndex) const
+  /**
+   * \brief Waits for the current rebuild to finish and swaps in the rebuilt
+   * tree.
+   *
+   * \details This function has no effect if no rebuild is in progress.
+   *
+   * \since 0.3.0
+   */
+  void wait_and_swap()
   {
-    if (nodeIndex == std::nullopt) {
-      return;
+    if (is_rebuilding()) {
+      swap_in(m_pending.get());
     }
+  }
 
-    const auto& node = m_nodes.at(*nodeIndex);
+  /**
+   * \brief Indicates whether or not a rebuild is in progress.
+   *
+   * \return `true` if a rebuilt tree hasn't been swapped in yet; `false`
+   * otherwise.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto is_rebuilding() const noexcept -> bool
+  {
+    return m_pending.valid();
+  }
 
-    if (nodeIndex == m_root) {
-      assert(node.parent == std::nullopt);
-    }
+  /**
+   * \brief Returns the amount of modified entries that haven't been handed
+   * over to the rebuild yet.
+   *
+   * \return the amount of entries that the next replay will process.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto dirty_count() const noexcept -> size_type
+  {
+    return m_dirty.size();
+  }
 
-    const auto left = node.left;
-    const auto right = node.right;
+  /**
+   * \brief Returns the current tree, which should be used for queries.
+   *
+   * \return the tree that is currently in use.
+   *
+   * \since 0.3.0
+   */
+  [[nodiscard]] auto get_tree() const noexcept -> const tree_type&
+  {
+    return m_tree;
+  }
 
-    if (node.is_leaf()) {
-      assert(left == std::nullopt);
-      assert(right == std::nullopt);
-      assert(node.height == 0);
-    } else {
-      assert(left < m_nodeCapacity);
-      assert(right < m_nodeCapacity);
-      assert(left != std::nullopt);
-      assert(right != std::nullopt);
+ private:
+  using node_type = typename tree_type::node_type;
 
-      assert(m_nodes.at(*left).parent == nodeIndex);
-      assert(m_nodes.at(*right).parent == nodeIndex);
+  /// The latest AABBs of modified entries, `std::nullopt` for removed ones.
+  using dirty_map = std::unordered_map<key_type, std::optional<aabb_type>>;
 
-      validate_structure(left);
-      validate_structure(right);
+  /// The state that is handed over to and back from the worker thread.
+  struct rebuild_state final
+  {
+    std::unique_ptr<tree_type> tree;
+    std::vector<node_type> snapshot;
+  };
+
+  /// The maximum amount of replays on the worker thread per rebuild.
+  static constexpr int maxCatchUpRounds = 4;
+
+  tree_type m_tree;
+  std::unique_ptr<tree_type> m_back;
+  std::vector<node_type> m_snapshot;
+  std::future<rebuild_state> m_pending;
+  dirty_map m_dirty;
+  int m_catchUpRounds{0};
+
+  void mark_dirty(const key_type& key)
+  {
+    if (!is_rebuilding()) {
+      return;
+    }
+
+    if (m_tree.contains(key)) {
+      m_dirty.insert_or_assign(key, m_tree.get_aabb(key));
+    } else {
+      m_dirty.insert_or_assign(key, std::nullopt);
     }
   }
 
-  void validate_metrics(const maybe_index nodeIndex) const
+  /**
+   * \brief Replays the recorded modifications in a rebuilt tree.
+   *
+   * \param fresh the rebuilt tree.
+   * \param dirty the latest states of the modified entries.
+   *
+   * \since 0.3.0
+   */
+  static void replay(tree_type& fresh, const dirty_map& dirty)
   {
-    if (nodeIndex == std::nullopt) {
-      return;
+    // The recorded AABBs are already fattened
+    const auto thicknessFactor = fresh.thickness_factor();
+    fresh.set_thickness_factor(std::nullopt);
+
+    for (const auto& [key, aabb] : dirty) {
+      if (!aabb) {
+        fresh.erase(key);
+      } else if (fresh.contains(key)) {
+        fresh.update(key, *aabb, true);
+      } else {
+        fresh.insert(key, aabb->min(), aabb->max());
+      }
     }
 
-    const auto& node = m_nodes.at(*nodeIndex);
-    const auto left = node.left;
-    const auto right = node.right;
+    fresh.set_thickness_factor(thicknessFactor);
+  }
 
-    if (node.is_leaf()) {
-      assert(left == std::nullopt);
-      assert(right == std::nullopt);
-      assert(node.height == 0);
-      return;
-    } else {
-      assert(left < m_nodeCapacity);
-      assert(right < m_nodeCapacity);
-      assert(left != std::nullopt);
-      assert(right != std::nullopt);
+  /**
+   * \brief Hands the recorded modifications over to the worker thread, which
+   * replays them in the rebuilt tree.
+   *
+   * \param state the state of the finished rebuild.
+   *
+   * \since 0.3.0
+   */
+  void catch_up(rebuild_state state)
+  {
+    ++m_catchUpRounds;
 
-      const auto leftHeight = m_nodes.at(*left).height;
-      const auto rightHeight = m_nodes.at(*right).height;
-      const auto height = 1 + std::max(leftHeight, rightHeight);
-      assert(node.height == height);
+    m_pending = std::async(
+        std::launch::async,
+        [dirty = std::move(m_dirty), state = std::move(state)]() mutable {
+          replay(*state.tree, dirty);
+          return std::move(state);
+        });
 
-      const auto aabb =
-          aabb_type::merge(m_nodes.at(*left).aabb, m_nodes.at(*right).aabb);
+    m_dirty.clear();
+  }
 
-      for (auto i = 0; i < 2; ++i) {
-        assert(aabb.min()[i] == node.aabb.min()[i]);
-        assert(aabb.max()[i] == node.aabb.max()[i]);
-      }
+  void swap_in(rebuild_state state)
+  {
+    replay(*state.tree, m_dirty);
+    m_dirty.clear();
 
-      validate_metrics(left);
-      validate_metrics(right);
-    }
+    std::swap(m_tree, *state.tree);
+    m_back = std::move(state.tree);
+    m_snapshot = std::move(state.snapshot);
   }
 };
 
@@ -0,0 +1,75 @@
+#include <doctest.h>
+
+#include <algorithm>  // max
+#include <chrono>     // duration, milliseconds
+#include <cstddef>    // size_t
+#include <iostream>   // clog
+#include <string>     // string
+#include <thread>     // this_thread
+
+#include "benchmark_utils.hpp"
+
+TEST_SUITE("async benchmark")
+{
+  TEST_CASE("Blocking rebuild vs background rebuild")
+  {
+    std::clog << "\n--- blocking rebuild vs rebuild_async ---\n";
+
+    for (const std::size_t count : {100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count);
+
+      auto blocking = bench::make_tree(boxes);
+      const auto blockingTime = bench::measure(
+          [&] { blocking.rebuild(abby::rebuild_strategy::lbvh); });
+
+      abby::async_tree<int> tree{2 * count};
+      for (std::size_t i = 0; i < count; ++i) {
+        tree.insert(static_cast<int>(i), boxes[i].min(), boxes[i].max());
+      }
+
+      // The first rebuild allocates the snapshot buffer, the second reuses it
+      std::size_t frameCount{0};
+      for (const auto* label : {"first ", "second "}) {
+        const auto startTime = bench::measure([&] { tree.rebuild_async(); });
+
+        // Keep moving a few entries every 16 ms frame until the rebuild is
+        // done
+        const abby::vector2<double> offset{0.5, 0.5};
+        std::size_t rebuildFrameCount{0};
+        double maxFrameTime{0};
+        double maxSwapTime{0};
+
+        while (tree.is_rebuilding()) {
+          const auto frameTime = bench::measure([&] {
+            for (std::size_t i = 0; i < 100; ++i) {
+              const auto key = (frameCount * 100 + i) % count;
+              const auto& box = boxes[key];
+              tree.update(static_cast<int>(key),
+                          {box.min() + offset, box.max() + offset});
+            }
+          });
+
+          const auto swapTime = bench::measure([&] { tree.swap_if_ready(); });
+          maxFrameTime = std::max(maxFrameTime, frameTime);
+          maxSwapTime = std::max(maxSwapTime, swapTime);
+          ++frameCount;
+          ++rebuildFrameCount;
+
+          const std::chrono::duration<double, std::milli> idle{
+              std::max(0.0, 16.0 - frameTime - swapTime)};
+          std::this_thread::sleep_for(idle);
+        }
+
+        CHECK(tree.get_tree().size() == count);
+
+        const std::string prefix{label};
+        bench::print_row(prefix + "rebuild_async call", count, startTime);
+        bench::print_row(prefix + "slowest swap_if_ready", count, maxSwapTime);
+        bench::print_row(prefix + "slowest update frame", count, maxFrameTime);
+        std::clog << "  frames until swap: " << rebuildFrameCount << '\n';
+      }
+
+      bench::print_row("blocking rebuild", count, blockingTime);
+    }
+  }
+}
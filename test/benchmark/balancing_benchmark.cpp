@@ -0,0 +1,242 @@
+#include <doctest.h>
+
+#include <algorithm>  // max
+#include <chrono>     // duration
+#include <cmath>      // sqrt
+#include <cstddef>    // size_t
+#include <iostream>   // clog
+#include <string>     // string
+#include <utility>    // pair
+#include <vector>     // vector
+
+#include "benchmark_utils.hpp"
+
+namespace {
+
+/**
+ * \brief Moves every box and updates the tree accordingly.
+ */
+void step(abby::tree<int>& tree,
+          std::vector<bench::aabb_t>& boxes,
+          std::vector<abby::vector2<double>>& velocities,
+          const double extent)
+{
+  bench::move_boxes(boxes, velocities, extent);
+  for (std::size_t i = 0; i < boxes.size(); ++i) {
+    tree.update(static_cast<int>(i), boxes[i]);
+  }
+}
+
+}  // namespace
+
+TEST_SUITE("balancing benchmark")
+{
+  TEST_CASE("Height balancing vs surface area rotations")
+  {
+    std::clog << "\n--- balancing strategies, 300 frames of moving boxes ---\n";
+
+    constexpr auto frameCount = 300;
+
+    for (const std::size_t count : {1'000u, 10'000u}) {
+      const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+      using abby::balancing_strategy;
+      for (const auto& [label, strategy] :
+           {std::pair{"height", balancing_strategy::height},
+            std::pair{"surface area", balancing_strategy::surface_area},
+            std::pair{"none", balancing_strategy::none}}) {
+        auto boxes = bench::make_boxes(count);
+        auto velocities = bench::make_velocities(count);
+
+        auto tree = bench::make_tree(boxes);
+        tree.set_balancing_strategy(strategy);
+
+        const auto queryBefore = bench::measure_queries(tree, boxes);
+        const auto ratioBefore = tree.compute_surface_area_ratio();
+
+        const auto updateTime = bench::measure([&] {
+          for (auto frame = 0; frame < frameCount; ++frame) {
+            step(tree, boxes, velocities, extent);
+          }
+        });
+
+        const auto queryAfter = bench::measure_queries(tree, boxes);
+        const auto ratioAfter = tree.compute_surface_area_ratio();
+
+        CHECK(tree.size() == count);
+
+        const std::string name{label};
+        bench::print_row(name + ": updates", count, updateTime);
+        bench::print_row(name + ": queries before", count, queryBefore);
+        std::clog << "  SAR: " << ratioBefore << '\n';
+        bench::print_row(name + ": queries after", count, queryAfter);
+        std::clog << "  SAR: " << ratioAfter << ", height: " << tree.height()
+                  << '\n';
+      }
+    }
+  }
+
+  TEST_CASE("Balancing strategies in a static scene")
+  {
+    std::clog << "\n--- balancing strategies, 10 frames of churn in a static "
+                 "scene ---\n";
+
+    // Every frame, 1% of the entries despawn and respawn elsewhere
+    constexpr auto frameCount = 10;
+
+    for (const std::size_t count : {10'000u, 100'000u}) {
+      const auto boxes = bench::make_boxes(count);
+      const auto respawned = bench::make_boxes(count, 7);
+      const auto churn = count / 100;
+
+      using abby::balancing_strategy;
+      for (const auto& [label, strategy] :
+           {std::pair{"height", balancing_strategy::height},
+            std::pair{"surface area", balancing_strategy::surface_area},
+            std::pair{"none", balancing_strategy::none}}) {
+        auto tree = bench::make_tree(boxes);
+        tree.rebuild(abby::rebuild_strategy::binned_sah);
+        tree.set_balancing_strategy(strategy);
+
+        const auto ratioBefore = tree.compute_surface_area_ratio();
+
+        std::size_t next{0};
+        const auto churnTime = bench::measure([&] {
+          for (auto frame = 0; frame < frameCount; ++frame) {
+            for (std::size_t i = 0; i < churn; ++i, ++next) {
+              const auto key = static_cast<int>(next % count);
+              const auto& box = (frame % 2 == 0) ? respawned[next % count]
+                                                 : boxes[next % count];
+              tree.erase(key);
+              tree.insert(key, box.min(), box.max());
+            }
+          }
+        });
+
+        const auto queryTime = bench::measure_queries(tree, boxes);
+
+        CHECK(tree.size() == count);
+
+        const std::string name{label};
+        bench::print_row(name + ": erase and insert", count, churnTime);
+        bench::print_row(name + ": queries after", count, queryTime);
+        std::clog << "  SAR: " << ratioBefore << " -> "
+                  << tree.compute_surface_area_ratio()
+                  << ", height: " << tree.height() << '\n';
+      }
+    }
+  }
+
+  TEST_CASE("Updates with and without optimize")
+  {
+    std::clog << "\n--- optimize every frame, 300 frames of moving boxes ---\n";
+
+    constexpr auto frameCount = 300;
+
+    for (const std::size_t count : {1'000u, 10'000u}) {
+      const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+      // Reinsert 0.1% or 1% of the nodes every frame, or none at all
+      for (const std::size_t budget :
+           {std::size_t{0}, count / 1'000, count / 100}) {
+        auto boxes = bench::make_boxes(count);
+        auto velocities = bench::make_velocities(count);
+        auto tree = bench::make_tree(boxes);
+
+        const auto frameTime = bench::measure([&] {
+          for (auto frame = 0; frame < frameCount; ++frame) {
+            step(tree, boxes, velocities, extent);
+            tree.optimize(budget);
+          }
+        });
+
+        const auto queryTime = bench::measure_queries(tree, boxes);
+
+        CHECK(tree.size() == count);
+
+        const auto label = "budget " + std::to_string(budget);
+        bench::print_row(label + ": updates", count, frameTime);
+        bench::print_row(label + ": queries after", count, queryTime);
+        std::clog << "  SAR: " << tree.compute_surface_area_ratio() << '\n';
+      }
+    }
+  }
+
+  TEST_CASE("Cost of a single optimize call")
+  {
+    std::clog << "\n--- optimize(10), average of 100 calls ---\n";
+
+    constexpr auto callCount = 100;
+
+    for (const std::size_t count : {10'000u, 100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count);
+      auto tree = bench::make_tree(boxes);
+
+      const auto time = bench::measure([&] {
+        for (auto call = 0; call < callCount; ++call) {
+          tree.optimize(10);
+        }
+      });
+
+      CHECK(tree.size() == count);
+
+      bench::print_row("optimize(10)", count, time / callCount);
+    }
+  }
+
+  TEST_CASE("Updates with and without a rebuild policy")
+  {
+    std::clog << "\n--- rebuild policy, 300 frames of moving boxes ---\n";
+
+    constexpr auto frameCount = 300;
+
+    for (const std::size_t count : {1'000u, 10'000u}) {
+      const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+      for (const auto usePolicy : {false, true}) {
+        auto boxes = bench::make_boxes(count);
+        auto velocities = bench::make_velocities(count);
+        auto tree = bench::make_tree(boxes);
+        tree.rebuild(abby::rebuild_strategy::binned_sah);
+
+        if (usePolicy) {
+          abby::rebuild_policy policy;
+          policy.threshold = 1.2;
+          tree.set_rebuild_policy(policy);
+        }
+
+        // The maintenance is performed at the end of every frame
+        auto worstFrame = 0.0;
+        const auto frameTime = bench::measure([&] {
+          for (auto frame = 0; frame < frameCount; ++frame) {
+            worstFrame = std::max(worstFrame, bench::measure([&] {
+              step(tree, boxes, velocities, extent);
+              tree.maintain();
+            }));
+          }
+        });
+
+        const auto queryTime = bench::measure_queries(tree, boxes);
+
+        CHECK(tree.size() == count);
+
+        const std::string label = usePolicy ? "policy" : "no policy";
+        bench::print_row(label + ": updates", count, frameTime);
+        bench::print_row(label + ": worst frame", count, worstFrame);
+        bench::print_row(label + ": queries after", count, queryTime);
+        std::clog << "  SAR: " << tree.compute_surface_area_ratio() << '\n';
+
+        if (usePolicy) {
+          const auto& stats = tree.get_rebuild_stats();
+          const auto ms = std::chrono::duration<double, std::milli>(stats.time);
+          std::clog << "  checks: " << stats.checks
+                    << ", rebuilds: " << stats.rebuilds
+                    << ", maintenance: " << ms.count() << " ms ("
+                    << (ms.count() * 1'000'000.0 /
+                        static_cast<double>(stats.checks))
+                    << " ns per check)\n";
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>  // max
+#include <chrono>     // steady_clock, duration
+#include <cmath>      // sqrt
+#include <cstddef>    // size_t
+#include <iomanip>    // setw
+#include <iostream>   // clog
+#include <iterator>   // back_inserter
+#include <random>     // mt19937, uniform_real_distribution
+#include <string>     // string
+#include <vector>     // vector
+
+#include "abby.hpp"
+
+namespace bench {
+
+using aabb_t = abby::aabb<double>;
+
+/**
+ * \brief Returns the time it takes to invoke the supplied function, in
+ * milliseconds.
+ */
+template <typename Fn>
+[[nodiscard]] auto measure(Fn&& fn) -> double
+{
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/**
+ * \brief Creates uniformly distributed square boxes in a world whose area grows
+ * with the amount of boxes, so that the average amount of overlaps per box is
+ * roughly constant.
+ */
+[[nodiscard]] inline auto make_boxes(const std::size_t count,
+                                     const unsigned seed = 42)
+    -> std::vector<aabb_t>
+{
+  const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+  std::mt19937 engine{seed};
+  std::uniform_real_distribution<double> position{0, extent};
+  std::uniform_real_distribution<double> size{1, 10};
+
+  std::vector<aabb_t> boxes;
+  boxes.reserve(count);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const abby::vector2<double> min{position(engine), position(engine)};
+    const abby::vector2<double> max{min.x + size(engine), min.y + size(engine)};
+    boxes.emplace_back(min, max);
+  }
+
+  return boxes;
+}
+
+/**
+ * \brief Creates random velocities with components in the range
+ * [-speed, speed].
+ */
+[[nodiscard]] inline auto make_velocities(const std::size_t count,
+                                          const double speed = 1.0)
+    -> std::vector<abby::vector2<double>>
+{
+  std::mt19937 engine{7};
+  std::uniform_real_distribution<double> component{-speed, speed};
+
+  std::vector<abby::vector2<double>> velocities;
+  velocities.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    velocities.push_back({component(engine), component(engine)});
+  }
+
+  return velocities;
+}
+
+/**
+ * \brief Moves every box along its velocity, reflecting the velocity at the
+ * boundaries of a square world with the specified extent.
+ */
+inline void move_boxes(std::vector<aabb_t>& boxes,
+                       std::vector<abby::vector2<double>>& velocities,
+                       const double extent)
+{
+  for (std::size_t i = 0; i < boxes.size(); ++i) {
+    auto& box = boxes[i];
+    auto& velocity = velocities[i];
+
+    if (box.min().x + velocity.x < 0 || box.max().x + velocity.x > extent) {
+      velocity.x = -velocity.x;
+    }
+
+    if (box.min().y + velocity.y < 0 || box.max().y + velocity.y > extent) {
+      velocity.y = -velocity.y;
+    }
+
+    box = {box.min() + velocity, box.max() + velocity};
+  }
+}
+
+/**
+ * \brief Creates a tree by inserting the boxes one by one, the keys are the
+ * indices of the boxes. By default, the node pool fits exactly the boxes.
+ */
+template <typename Key = int>
+[[nodiscard]] auto make_tree(const std::vector<aabb_t>& boxes,
+                             const std::size_t capacity = 0) -> abby::tree<Key>
+{
+  abby::tree<Key> tree{std::max(capacity, boxes.size() * 2)};
+
+  Key key{0};
+  for (const auto& box : boxes) {
+    tree.insert(key, box.min(), box.max());
+    ++key;
+  }
+
+  return tree;
+}
+
+/**
+ * \brief Returns the time it takes to query the tree with every box.
+ */
+template <typename Tree>
+[[nodiscard]] auto measure_queries(const Tree& tree,
+                                   const std::vector<aabb_t>& boxes) -> double
+{
+  std::vector<int> candidates;
+  candidates.reserve(256);
+
+  return measure([&] {
+    for (const auto& box : boxes) {
+      candidates.clear();
+      tree.query(box, std::back_inserter(candidates));
+    }
+  });
+}
+
+inline void print_row(const std::string& label,
+                      const std::size_t count,
+                      const double ms)
+{
+  std::clog << std::left << std::setw(32) << label << std::right
+            << std::setw(10) << count << std::setw(14) << std::fixed
+            << std::setprecision(3) << ms << " ms\n";
+}
+
+}  // namespace bench
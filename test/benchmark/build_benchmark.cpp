@@ -0,0 +1,256 @@
+#include <doctest.h>
+
+#include <cstddef>   // size_t
+#include <iostream>  // clog
+#include <optional>  // optional
+#include <string>    // to_string
+#include <tuple>     // tuple
+#include <utility>   // pair
+#include <vector>    // vector
+
+#include "benchmark_utils.hpp"
+
+TEST_SUITE("build benchmark")
+{
+  TEST_CASE("Incremental insertion vs rebuild strategies")
+  {
+    std::clog << "\n--- incremental insertion vs rebuild strategies ---\n";
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count);
+
+      abby::tree<int> tree;
+      const auto insertTime = bench::measure([&] {
+        tree = bench::make_tree(boxes);
+      });
+      const auto insertRatio = tree.compute_surface_area_ratio();
+
+      // The greedy rebuild is cubic, so it is only feasible for small trees
+      if (count <= 1'000u) {
+        auto copy = tree;
+        const auto greedyTime = bench::measure([&] { copy.rebuild(); });
+        bench::print_row("greedy rebuild", count, greedyTime);
+        std::clog << "  SAR: " << copy.compute_surface_area_ratio() << '\n';
+      }
+
+      bench::print_row("incremental insertion", count, insertTime);
+      std::clog << "  SAR: " << insertRatio << '\n';
+
+      for (const auto& [label, strategy] :
+           {std::pair{"binned SAH rebuild", abby::rebuild_strategy::binned_sah},
+            std::pair{"LBVH rebuild", abby::rebuild_strategy::lbvh},
+            std::pair{"PLOC rebuild", abby::rebuild_strategy::ploc}}) {
+        auto copy = tree;
+        const auto time = bench::measure([&] { copy.rebuild(strategy); });
+        const auto ratio = copy.compute_surface_area_ratio();
+
+        CHECK(copy.size() == count);
+        CHECK(ratio <= insertRatio);
+
+        bench::print_row(label, count, time);
+        std::clog << "  SAR: " << ratio << '\n';
+      }
+    }
+  }
+
+  TEST_CASE("Incremental insertion vs LBVH build")
+  {
+    std::clog << "\n--- incremental insertion vs LBVH build ---\n";
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count);
+
+      std::vector<std::pair<int, bench::aabb_t>> entries;
+      entries.reserve(count);
+      for (const auto& box : boxes) {
+        entries.emplace_back(static_cast<int>(entries.size()), box);
+      }
+
+      abby::tree<int> inserted;
+      const auto insertTime = bench::measure([&] {
+        inserted = bench::make_tree(boxes);
+      });
+
+      abby::tree<int> built;
+      const auto buildTime = bench::measure([&] {
+        built.build(entries.begin(), entries.end());
+      });
+
+      CHECK(built.size() == count);
+
+      bench::print_row("incremental insertion", count, insertTime);
+      std::clog << "  SAR: " << inserted.compute_surface_area_ratio() << '\n';
+      bench::print_row("LBVH build", count, buildTime);
+      std::clog << "  SAR: " << built.compute_surface_area_ratio() << '\n';
+    }
+  }
+
+  TEST_CASE("LBVH build thread scaling")
+  {
+    std::clog << "\n--- LBVH build thread scaling ---\n";
+
+    constexpr std::size_t count = 1'000'000;
+    const auto boxes = bench::make_boxes(count);
+
+    std::vector<std::pair<int, bench::aabb_t>> entries;
+    entries.reserve(count);
+    for (const auto& box : boxes) {
+      entries.emplace_back(static_cast<int>(entries.size()), box);
+    }
+
+    std::optional<double> expectedRatio;
+    for (const std::size_t threads : {1u, 2u, 4u, 8u, 16u, 32u}) {
+      abby::tree<int> tree;
+      const auto time = bench::measure([&] {
+        tree.build(entries.begin(), entries.end(), threads);
+      });
+
+      // The structure, and therefore the ratio, must not depend on the threads
+      const auto ratio = tree.compute_surface_area_ratio();
+      if (!expectedRatio) {
+        expectedRatio = ratio;
+      }
+      CHECK(ratio == *expectedRatio);
+
+      bench::print_row("LBVH build, " + std::to_string(threads) + " threads",
+                       count,
+                       time);
+    }
+  }
+
+  TEST_CASE("LBVH build with treelet optimization")
+  {
+    std::clog << "\n--- LBVH build with treelet optimization ---\n";
+
+    for (const std::size_t count : {10'000u, 100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count);
+
+      std::vector<std::pair<int, bench::aabb_t>> entries;
+      entries.reserve(count);
+      for (const auto& box : boxes) {
+        entries.emplace_back(static_cast<int>(entries.size()), box);
+      }
+
+      abby::tree<int> tree;
+      const auto buildTime = bench::measure([&] {
+        tree.build(entries.begin(), entries.end());
+      });
+
+      auto sah = tree;
+      const auto sahTime = bench::measure([&] {
+        sah.rebuild(abby::rebuild_strategy::binned_sah);
+      });
+
+      bench::print_row("LBVH build", count, buildTime);
+      std::clog << "  SAR: " << tree.compute_surface_area_ratio() << '\n';
+      bench::print_row("LBVH build: query",
+                       count,
+                       bench::measure_queries(tree, boxes));
+
+      for (const std::size_t passes : {1u, 2u, 4u}) {
+        auto copy = tree;
+        const auto time = bench::measure([&] {
+          copy.optimize_treelets(passes);
+        });
+
+        const auto label = std::to_string(passes) + " treelet passes";
+        bench::print_row(label, count, time);
+        std::clog << "  SAR: " << copy.compute_surface_area_ratio() << '\n';
+        bench::print_row(label + ": query",
+                         count,
+                         bench::measure_queries(copy, boxes));
+      }
+
+      bench::print_row("binned SAH rebuild", count, sahTime);
+      std::clog << "  SAR: " << sah.compute_surface_area_ratio() << '\n';
+      bench::print_row("binned SAH rebuild: query",
+                       count,
+                       bench::measure_queries(sah, boxes));
+    }
+  }
+
+  TEST_CASE("Treelet optimization thread scaling")
+  {
+    std::clog << "\n--- treelet optimization thread scaling ---\n";
+
+    constexpr std::size_t count = 1'000'000;
+    const auto boxes = bench::make_boxes(count);
+
+    std::vector<std::pair<int, bench::aabb_t>> entries;
+    entries.reserve(count);
+    for (const auto& box : boxes) {
+      entries.emplace_back(static_cast<int>(entries.size()), box);
+    }
+
+    abby::tree<int> tree;
+    tree.build(entries.begin(), entries.end());
+
+    std::optional<double> expectedRatio;
+    for (const std::size_t threads : {1u, 2u, 4u, 8u}) {
+      auto copy = tree;
+      const auto time = bench::measure([&] {
+        copy.optimize_treelets(1, threads);
+      });
+
+      // The selected treelets and their topologies don't depend on the threads
+      const auto ratio = copy.compute_surface_area_ratio();
+      if (!expectedRatio) {
+        expectedRatio = ratio;
+      }
+      CHECK(ratio == *expectedRatio);
+
+      bench::print_row(std::to_string(threads) + " threads", count, time);
+    }
+  }
+
+  TEST_CASE("Insert loop vs insert_range")
+  {
+    std::clog << "\n--- insert loop vs insert_range, 10k entries ---\n";
+
+    using vector_t = abby::vector2<double>;
+    using entry_t = std::tuple<int, vector_t, vector_t>;
+
+    constexpr std::size_t batchSize = 10'000;
+
+    for (const std::size_t count : {10'000u, 100'000u, 1'000'000u}) {
+      const auto boxes = bench::make_boxes(count + batchSize);
+      const std::vector<bench::aabb_t> existing{boxes.begin(),
+                                                boxes.end() - batchSize};
+
+      std::vector<entry_t> batch;
+      batch.reserve(batchSize);
+      for (auto i = count; i < boxes.size(); ++i) {
+        batch.emplace_back(static_cast<int>(i), boxes[i].min(), boxes[i].max());
+      }
+
+      // Make room for the batch, so that the node pool doesn't have to grow
+      auto looped = bench::make_tree(existing, 2 * boxes.size());
+      const auto loopTime = bench::measure([&] {
+        for (const auto& [key, lower, upper] : batch) {
+          looped.insert(key, lower, upper);
+        }
+      });
+
+      auto ranged = bench::make_tree(existing, 2 * boxes.size());
+      const auto rangeTime = bench::measure([&] {
+        ranged.insert_range(batch.begin(), batch.end());
+      });
+
+      CHECK(looped.size() == ranged.size());
+
+      // The spliced subtree trades query performance for insertion speed, the
+      // inserted boxes are spread over the whole world and serve as queries
+      const std::vector<bench::aabb_t> queries{boxes.end() - batchSize,
+                                               boxes.end()};
+      const auto loopQueryTime = bench::measure_queries(looped, queries);
+      const auto rangeQueryTime = bench::measure_queries(ranged, queries);
+
+      bench::print_row("insert loop", count, loopTime);
+      bench::print_row("  queries after", count, loopQueryTime);
+      std::clog << "  SAR: " << looped.compute_surface_area_ratio() << '\n';
+      bench::print_row("insert_range", count, rangeTime);
+      bench::print_row("  queries after", count, rangeQueryTime);
+      std::clog << "  SAR: " << ranged.compute_surface_area_ratio() << '\n';
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#include <doctest.h>
+
+#include <algorithm>  // sort
+#include <cmath>      // sqrt
+#include <cstddef>    // size_t
+#include <iostream>   // clog
+#include <random>     // mt19937, normal_distribution
+#include <string>     // string
+#include <utility>    // pair
+#include <vector>     // vector
+
+#include "benchmark_utils.hpp"
+
+namespace {
+
+/**
+ * \brief Creates boxes that are sorted by their x-coordinate, which is what
+ * loading a level row by row looks like.
+ */
+[[nodiscard]] auto make_sorted_boxes(const std::size_t count)
+    -> std::vector<bench::aabb_t>
+{
+  auto boxes = bench::make_boxes(count);
+  std::sort(boxes.begin(), boxes.end(), [](const auto& a, const auto& b) {
+    return a.min().x < b.min().x;
+  });
+  return boxes;
+}
+
+/**
+ * \brief Creates boxes that are normally distributed around a few centres,
+ * like groups of spawned entities.
+ */
+[[nodiscard]] auto make_clustered_boxes(const std::size_t count)
+    -> std::vector<bench::aabb_t>
+{
+  constexpr std::size_t clusterCount = 16;
+
+  const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+  const auto spread = extent / 32.0;
+
+  auto centres = bench::make_boxes(clusterCount, 7);
+
+  std::mt19937 engine{42};
+  std::normal_distribution<double> offset{0, spread};
+
+  std::vector<bench::aabb_t> boxes;
+  boxes.reserve(count);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto& centre = centres[i % clusterCount].min();
+    const abby::vector2<double> min{centre.x * 32.0 + offset(engine),
+                                    centre.y * 32.0 + offset(engine)};
+    boxes.emplace_back(min, min + abby::vector2<double>{2, 2});
+  }
+
+  return boxes;
+}
+
+}  // namespace
+
+TEST_SUITE("insertion benchmark")
+{
+  TEST_CASE("Greedy vs branch and bound insertion")
+  {
+    std::clog << "\n--- greedy vs branch and bound insertion ---\n";
+
+    using abby::insertion_strategy;
+
+    for (const std::size_t count : {10'000u, 100'000u}) {
+      for (const auto& [pattern, boxes] :
+           {std::pair{std::string{"uniform"}, bench::make_boxes(count)},
+            std::pair{std::string{"sorted"}, make_sorted_boxes(count)},
+            std::pair{std::string{"clustered"}, make_clustered_boxes(count)}}) {
+        for (const auto& [label, strategy] :
+             {std::pair{"greedy", insertion_strategy::greedy},
+              std::pair{"B&B", insertion_strategy::branch_and_bound}}) {
+          abby::tree<int> tree{2 * count};
+          tree.set_insertion_strategy(strategy);
+
+          const auto insertTime = bench::measure([&] {
+            for (std::size_t i = 0; i < count; ++i) {
+              const auto& box = boxes[i];
+              tree.insert(static_cast<int>(i), box.min(), box.max());
+            }
+          });
+
+          const auto queryTime = bench::measure_queries(tree, boxes);
+
+          CHECK(tree.size() == count);
+
+          const auto name = pattern + ", " + label;
+          bench::print_row(name + ": insert", count, insertTime);
+          bench::print_row(name + ": query", count, queryTime);
+          std::clog << "  SAR: " << tree.compute_surface_area_ratio() << '\n';
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include <doctest.h>
+
+#include <cmath>     // sqrt
+#include <cstddef>   // size_t
+#include <iostream>  // clog
+#include <random>    // mt19937, uniform_real_distribution
+#include <string>    // string
+#include <utility>   // pair
+#include <vector>    // vector
+
+#include "benchmark_utils.hpp"
+
+namespace {
+
+/**
+ * \brief Creates long and thin horizontal and vertical boxes, like the
+ * corridors of a level.
+ */
+[[nodiscard]] auto make_corridors(const std::size_t count)
+    -> std::vector<bench::aabb_t>
+{
+  const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+  std::mt19937 engine{42};
+  std::uniform_real_distribution<double> position{0, extent};
+  std::uniform_real_distribution<double> length{20, 100};
+  std::uniform_real_distribution<double> width{0.5, 2};
+
+  std::vector<bench::aabb_t> boxes;
+  boxes.reserve(count);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const abby::vector2<double> min{position(engine), position(engine)};
+    const auto major = length(engine);
+    const auto minor = width(engine);
+
+    if (i % 2 == 0) {
+      boxes.emplace_back(min, min + abby::vector2<double>{major, minor});
+    } else {
+      boxes.emplace_back(min, min + abby::vector2<double>{minor, major});
+    }
+  }
+
+  return boxes;
+}
+
+template <typename CostMetric>
+void run(const std::string& name, const std::vector<bench::aabb_t>& boxes)
+{
+  using tree_type = abby::tree<int, double, abby::no_aggregate, CostMetric>;
+
+  const auto count = boxes.size();
+
+  tree_type tree{2 * count};
+  const auto insertTime = bench::measure([&] {
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto& box = boxes[i];
+      tree.insert(static_cast<int>(i), box.min(), box.max());
+    }
+  });
+
+  CHECK(tree.size() == count);
+
+  bench::print_row(name + ": insert", count, insertTime);
+  bench::print_row(name + ": query",
+                   count,
+                   bench::measure_queries(tree, boxes));
+
+  tree.rebuild(abby::rebuild_strategy::binned_sah);
+  bench::print_row(name + ": SAH query",
+                   count,
+                   bench::measure_queries(tree, boxes));
+}
+
+}  // namespace
+
+TEST_SUITE("metric benchmark")
+{
+  TEST_CASE("Perimeter vs area cost metric")
+  {
+    std::clog << "\n--- perimeter vs area cost metric ---\n";
+
+    for (const std::size_t count : {10'000u, 100'000u}) {
+      for (const auto& [pattern, boxes] :
+           {std::pair{std::string{"uniform"}, bench::make_boxes(count)},
+            std::pair{std::string{"corridors"}, make_corridors(count)}}) {
+        run<abby::perimeter_metric>(pattern + ", perimeter", boxes);
+        run<abby::area_metric>(pattern + ", area", boxes);
+      }
+    }
+  }
+}
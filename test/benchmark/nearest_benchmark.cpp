@@ -0,0 +1,89 @@
+#include <doctest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+
+namespace {
+
+/**
+ * \brief Finds the closest entry by querying with a growing search radius,
+ * which is how the closest entry had to be found before nearest_distance().
+ */
+auto nearest_by_growing_radius(const abby::tree<int>& tree,
+                               const int key,
+                               std::vector<int>& candidates) -> double
+{
+  const auto& source = tree.get_aabb(key);
+
+  for (auto radius = 1.0;; radius *= 2) {
+    const abby::vector2<double> offset{radius, radius};
+    const bench::aabb_t region{source.min() - offset, source.max() + offset};
+
+    candidates.clear();
+    tree.query(region, std::back_inserter(candidates));
+
+    auto best = std::numeric_limits<double>::max();
+    for (const auto candidate : candidates) {
+      if (candidate == key) {
+        continue;
+      }
+
+      const auto& other = tree.get_aabb(candidate);
+      const auto dx = std::max({0.0,
+                                source.min().x - other.max().x,
+                                other.min().x - source.max().x});
+      const auto dy = std::max({0.0,
+                                source.min().y - other.max().y,
+                                other.min().y - source.max().y});
+      best = std::min(best, (dx * dx) + (dy * dy));
+    }
+
+    // Only entries within the radius are guaranteed to have been found
+    if (best <= radius * radius) {
+      return best;
+    }
+  }
+}
+
+}  // namespace
+
+TEST_SUITE("nearest benchmark")
+{
+  TEST_CASE("Growing-radius query vs nearest_distance")
+  {
+    std::clog << "\n--- growing-radius query vs nearest_distance ---\n";
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u}) {
+      const auto tree = bench::make_tree(bench::make_boxes(count));
+      const auto n = static_cast<int>(count);
+
+      std::vector<int> candidates;
+      candidates.reserve(256);
+
+      double querySum{0};
+      const auto queryTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          querySum += nearest_by_growing_radius(tree, key, candidates);
+        }
+      });
+
+      double nearestSum{0};
+      const auto nearestTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          const auto nearest = tree.nearest_distance(tree.get_aabb(key), key);
+          nearestSum += nearest->distanceSquared;
+        }
+      });
+
+      CHECK(querySum == doctest::Approx(nearestSum));
+
+      bench::print_row("growing-radius query", count, queryTime);
+      bench::print_row("nearest_distance", count, nearestTime);
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#include <doctest.h>
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+
+TEST_SUITE("query benchmark")
+{
+  TEST_CASE("Stack-based query vs stackless query")
+  {
+    std::clog << "\n--- query vs query_stackless (all keys) ---\n";
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u}) {
+      const auto tree = bench::make_tree(bench::make_boxes(count));
+      const auto n = static_cast<int>(count);
+
+      std::vector<int> candidates;
+      candidates.reserve(256);
+
+      std::size_t stackHits{0};
+      const auto stackTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          candidates.clear();
+          tree.query(key, std::back_inserter(candidates));
+          stackHits += candidates.size();
+        }
+      });
+
+      std::size_t stacklessHits{0};
+      const auto stacklessTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          candidates.clear();
+          tree.query_stackless(key, std::back_inserter(candidates));
+          stacklessHits += candidates.size();
+        }
+      });
+
+      CHECK(stackHits == stacklessHits);
+
+      bench::print_row("query", count, stackTime);
+      bench::print_row("query_stackless", count, stacklessTime);
+    }
+  }
+
+  TEST_CASE("Query followed by get_aabb vs query_with_aabbs")
+  {
+    std::clog << "\n--- query + get_aabb vs query_with_aabbs (all keys) ---\n";
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u}) {
+      const auto tree = bench::make_tree(bench::make_boxes(count));
+      const auto n = static_cast<int>(count);
+
+      std::vector<int> candidates;
+      candidates.reserve(256);
+
+      double lookupSum{0};
+      const auto lookupTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          candidates.clear();
+          tree.query(key, std::back_inserter(candidates));
+          for (const auto candidate : candidates) {
+            lookupSum += tree.get_aabb(candidate).area();
+          }
+        }
+      });
+
+      double directSum{0};
+      const auto directTime = bench::measure([&] {
+        for (auto key = 0; key < n; ++key) {
+          tree.query_with_aabbs(key, [&](int, const bench::aabb_t& aabb) {
+            directSum += aabb.area();
+          });
+        }
+      });
+
+      CHECK(lookupSum == doctest::Approx(directSum));
+
+      bench::print_row("query + get_aabb", count, lookupTime);
+      bench::print_row("query_with_aabbs", count, directTime);
+    }
+  }
+}
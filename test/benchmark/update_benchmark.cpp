@@ -0,0 +1,134 @@
+#include <doctest.h>
+
+#include <cmath>     // sqrt
+#include <cstddef>   // size_t
+#include <iostream>  // clog
+#include <string>    // string
+#include <utility>   // pair
+#include <vector>    // vector
+
+#include "benchmark_utils.hpp"
+
+TEST_SUITE("update benchmark")
+{
+  TEST_CASE("Update loop vs refit")
+  {
+    std::clog << "\n--- update loop vs refit, 100 frames of a crowd ---\n";
+
+    constexpr auto frameCount = 100;
+
+    for (const std::size_t count : {10'000u, 100'000u}) {
+      const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+      // Every entry moves a little every frame
+      auto boxes = bench::make_boxes(count);
+      auto velocities = bench::make_velocities(count, 0.25);
+      auto updated = bench::make_tree(boxes);
+      auto refitted = updated;
+
+      std::vector<std::pair<int, bench::aabb_t>> entries(count);
+
+      double updateTime{0};
+      double refitTime{0};
+
+      for (auto frame = 0; frame < frameCount; ++frame) {
+        bench::move_boxes(boxes, velocities, extent);
+
+        updateTime += bench::measure([&] {
+          for (std::size_t i = 0; i < count; ++i) {
+            updated.update(static_cast<int>(i), boxes[i]);
+          }
+        });
+
+        refitTime += bench::measure([&] {
+          for (std::size_t i = 0; i < count; ++i) {
+            entries[i] = {static_cast<int>(i), boxes[i]};
+          }
+          refitted.refit(entries.begin(), entries.end());
+        });
+      }
+
+      CHECK(updated.size() == refitted.size());
+
+      const auto updatedQueryTime = bench::measure_queries(updated, boxes);
+      const auto refittedQueryTime = bench::measure_queries(refitted, boxes);
+
+      bench::print_row("update loop", count, updateTime);
+      bench::print_row("  queries after", count, updatedQueryTime);
+      std::clog << "  SAR: " << updated.compute_surface_area_ratio() << '\n';
+      bench::print_row("refit", count, refitTime);
+      bench::print_row("  queries after", count, refittedQueryTime);
+      std::clog << "  SAR: " << refitted.compute_surface_area_ratio() << '\n';
+    }
+  }
+
+  TEST_CASE("Update loop vs update_batch")
+  {
+    std::clog << "\n--- update loop vs update_batch, 100 frames ---\n";
+
+    constexpr auto frameCount = 100;
+
+    for (const std::size_t count : {10'000u, 100'000u}) {
+      const auto extent = 10.0 * std::sqrt(static_cast<double>(count));
+
+      // The keys and AABBs are stored in contiguous arrays, as in an ECS
+      std::vector<int> keys(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        keys[i] = static_cast<int>(i);
+      }
+
+      // The height strategy is excluded, update_batch() falls back to update()
+      using abby::balancing_strategy;
+      for (const auto& [strategyLabel, strategy] :
+           {std::pair{"surface area", balancing_strategy::surface_area},
+            std::pair{"none", balancing_strategy::none}}) {
+        for (const auto speed : {0.25, 1.0}) {
+          auto boxes = bench::make_boxes(count);
+          auto velocities = bench::make_velocities(count, speed);
+          auto updated = bench::make_tree(boxes);
+          updated.set_balancing_strategy(strategy);
+          auto batched = updated;
+
+          double updateTime{0};
+          double batchTime{0};
+          std::size_t reinsertedCount{0};
+
+          for (auto frame = 0; frame < frameCount; ++frame) {
+            bench::move_boxes(boxes, velocities, extent);
+
+            updateTime += bench::measure([&] {
+              for (std::size_t i = 0; i < count; ++i) {
+                updated.update(keys[i], boxes[i]);
+              }
+            });
+
+            batchTime += bench::measure([&] {
+              reinsertedCount += batched.update_batch(keys.begin(),
+                                                      keys.end(),
+                                                      boxes.begin());
+            });
+          }
+
+          CHECK(updated.size() == batched.size());
+
+          std::clog << strategyLabel << ", speed "
+                    << std::to_string(speed).substr(0, 4) << ", "
+                    << (reinsertedCount / frameCount)
+                    << " reinsertions per frame\n";
+          bench::print_row("  update loop", count, updateTime);
+          bench::print_row("    queries after",
+                           count,
+                           bench::measure_queries(updated, boxes));
+          std::clog << "    SAR: " << updated.compute_surface_area_ratio()
+                    << ", height: " << updated.height() << '\n';
+          bench::print_row("  update_batch", count, batchTime);
+          bench::print_row("    queries after",
+                           count,
+                           bench::measure_queries(batched, boxes));
+          std::clog << "    SAR: " << batched.compute_surface_area_ratio()
+                    << ", height: " << batched.height() << '\n';
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#include <doctest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "abby.hpp"
+#include "test_utils.hpp"
+
+TEST_SUITE("async_tree")
+{
+  TEST_CASE("async_tree::rebuild_async")
+  {
+    abby::async_tree<int> tree;
+    CHECK(!tree.is_rebuilding());
+    CHECK(!tree.swap_if_ready());
+    CHECK_NOTHROW(tree.wait_and_swap());
+
+    const auto boxes = make_boxes(500);
+    for (auto i = 0; i < 500; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    const auto fattened = tree.get_tree().get_aabb(42);
+
+    REQUIRE(tree.rebuild_async(abby::rebuild_strategy::binned_sah));
+    CHECK(tree.is_rebuilding());
+    CHECK(!tree.rebuild_async());
+
+    // Modify the tree whilst the rebuild is in progress
+    tree.erase(0);
+    tree.erase(1);
+    tree.update(2, aabb_t{{500, 500}, {510, 510}});
+    tree.insert(1000, {600, 600}, {601, 601});
+    tree.insert(1, {700, 700}, {701, 701});
+
+    // Queries use the current tree until the swap
+    CHECK(!tree.get_tree().contains(0));
+    CHECK(tree.get_tree().contains(1000));
+    CHECK(tree.dirty_count() == 4);
+
+    tree.wait_and_swap();
+    CHECK(!tree.is_rebuilding());
+    CHECK(tree.dirty_count() == 0);
+
+    const auto& after = tree.get_tree();
+    CHECK(after.size() == 500);
+    CHECK(!after.contains(0));
+    CHECK(after.contains(1));
+    CHECK(after.contains(1000));
+
+    // The AABBs must not be fattened again by the rebuild
+    CHECK(after.get_aabb(42).min() == fattened.min());
+    CHECK(after.get_aabb(42).max() == fattened.max());
+
+    std::vector<int> candidates;
+    after.query(aabb_t{{499, 499}, {502, 502}}, std::back_inserter(candidates));
+    CHECK(candidates == std::vector<int>{2});
+
+    // The previous tree and snapshot buffer are reused by the next rebuild
+    REQUIRE(tree.rebuild_async());
+    while (!tree.swap_if_ready()) {
+    }
+
+    CHECK(tree.get_tree().size() == 500);
+    CHECK(tree.get_tree().contains(1));
+
+    // Keep modifying entries until the changes are few enough to be replayed
+    // by the swap, the rest is replayed on the worker thread
+    REQUIRE(tree.rebuild_async());
+
+    auto frame = 0;
+    do {
+      const auto x = 800.0 + frame;
+      tree.update(10 + frame % 10, aabb_t{{x, 0}, {x + 1, 1}});
+      ++frame;
+    } while (!tree.swap_if_ready(0));
+
+    CHECK(tree.dirty_count() == 0);
+    CHECK(tree.get_tree().size() == 500);
+
+    for (auto i = 0; i < std::min(frame, 10); ++i) {
+      const auto last = frame - 1 - ((frame - 1 - i) % 10);
+      const auto x = 800.0 + last;
+
+      candidates.clear();
+      tree.get_tree().query(aabb_t{{x, 0}, {x + 1, 1}},
+                            std::back_inserter(candidates));
+      CHECK(std::count(candidates.begin(), candidates.end(), 10 + i) == 1);
+    }
+  }
+}
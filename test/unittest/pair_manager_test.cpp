@@ -0,0 +1,100 @@
+#include <doctest.h>
+
+#include <utility>
+#include <vector>
+
+#include "abby.hpp"
+
+namespace {
+
+using pair_list = std::vector<std::pair<int, int>>;
+
+auto contains(const pair_list& pairs, int fst, int snd) -> bool
+{
+  for (const auto& [a, b] : pairs) {
+    if ((a == fst && b == snd) || (a == snd && b == fst)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST_SUITE("pair_manager")
+{
+  TEST_CASE("pair_manager::update_pairs")
+  {
+    abby::pair_manager<int> manager;
+
+    pair_list begun;
+    pair_list ended;
+
+    const auto update = [&] {
+      begun.clear();
+      ended.clear();
+      manager.update_pairs(
+          [&](int fst, int snd) {
+            begun.emplace_back(fst, snd);
+          },
+          [&](int fst, int snd) {
+            ended.emplace_back(fst, snd);
+          });
+    };
+
+    manager.insert(1, {0, 0}, {10, 10});
+    manager.insert(2, {5, 5}, {15, 15});
+    manager.insert(3, {100, 100}, {110, 110});
+    CHECK(manager.moved_count() == 3);
+
+    update();
+    CHECK(manager.moved_count() == 0);
+    CHECK(begun.size() == 1);
+    CHECK(contains(begun, 1, 2));
+    CHECK(ended.empty());
+    CHECK(manager.pair_count() == 1);
+    CHECK(manager.is_paired(1, 2));
+    CHECK(manager.is_paired(2, 1));
+
+    SUBCASE("Updates within the fattened AABB are not considered moves")
+    {
+      CHECK_FALSE(manager.update(3, {100.1, 100.1}, {109.9, 109.9}));
+      CHECK(manager.moved_count() == 0);
+
+      update();
+      CHECK(begun.empty());
+      CHECK(ended.empty());
+    }
+
+    SUBCASE("Pairs begin and end when entries move")
+    {
+      CHECK(manager.update(3, {8, 8}, {20, 20}));
+      update();
+      CHECK(begun.size() == 2);
+      CHECK(contains(begun, 3, 1));
+      CHECK(contains(begun, 3, 2));
+      CHECK(ended.empty());
+      CHECK(manager.pair_count() == 3);
+
+      CHECK(manager.relocate(1, {200, 200}));
+      update();
+      CHECK(begun.empty());
+      CHECK(ended.size() == 2);
+      CHECK(contains(ended, 1, 2));
+      CHECK(contains(ended, 1, 3));
+      CHECK(manager.pair_count() == 1);
+      CHECK(manager.is_paired(2, 3));
+    }
+
+    SUBCASE("Erased entries end their pairs")
+    {
+      manager.erase(2);
+      update();
+      CHECK(begun.empty());
+      CHECK(ended.size() == 1);
+      CHECK(contains(ended, 1, 2));
+      CHECK(manager.pair_count() == 0);
+      CHECK_FALSE(manager.is_paired(1, 2));
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <doctest.h>
+
+#include <algorithm>  // sort, includes
+#include <cstddef>    // size_t
+#include <iterator>   // back_inserter
+#include <vector>     // vector
+
+#include "abby.hpp"
+
+namespace {
+
+using aabb_t = abby::aabb<double>;
+
+/**
+ * \brief Creates boxes that are scattered over a world of 211 by 199 units,
+ * the box at index `i` is meant to be associated with the key `i`.
+ *
+ * \details The positions are deterministic and the boxes overlap more often
+ * the larger they are, which makes them suitable for both query and pair
+ * tests.
+ */
+[[nodiscard]] auto make_boxes(const int count,
+                              const abby::vector2<double> size = {3, 2})
+    -> std::vector<aabb_t>
+{
+  std::vector<aabb_t> boxes;
+  boxes.reserve(static_cast<std::size_t>(count));
+
+  for (auto i = 0; i < count; ++i) {
+    const auto x = static_cast<double>((i * 37) % 211);
+    const auto y = static_cast<double>((i * 53) % 199);
+    boxes.emplace_back(abby::vector2<double>{x, y},
+                       abby::vector2<double>{x + size.x, y + size.y});
+  }
+
+  return boxes;
+}
+
+/**
+ * \brief Checks that a query of the region reports every key in the tree whose
+ * box overlaps the region.
+ *
+ * \details The box at index `i` is the last box that was associated with the
+ * key `i`. Keys that are no longer in the tree are skipped. The query may
+ * report additional candidates due to the fattened AABBs.
+ */
+template <typename Tree>
+void expect_superset(const Tree& tree,
+                     const std::vector<aabb_t>& boxes,
+                     const aabb_t& region)
+{
+  std::vector<int> expected;
+  for (auto i = 0; i < static_cast<int>(boxes.size()); ++i) {
+    const auto& box = boxes.at(static_cast<std::size_t>(i));
+    if (tree.contains(i) && region.overlaps(box, true)) {
+      expected.push_back(i);
+    }
+  }
+
+  std::vector<int> candidates;
+  tree.query(region, std::back_inserter(candidates));
+  std::sort(candidates.begin(), candidates.end());
+
+  CHECK(std::includes(candidates.begin(),
+                      candidates.end(),
+                      expected.begin(),
+                      expected.end()));
+}
+
+}  // namespace
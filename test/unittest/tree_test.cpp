@@ -1,9 +1,17 @@
 #include <AABB.h>
 #include <doctest.h>
 
+#include <algorithm>
 #include <iterator>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
 
 #include "abby.hpp"
+#include "test_utils.hpp"
 
 TEST_SUITE("tree")
 {
@@ -144,6 +152,1091 @@ TEST_SUITE("tree")
     }
   }
 
+  TEST_CASE("tree::query with AABB")
+  {
+    abby::tree<int> tree;
+    tree.set_thickness_factor(std::nullopt);
+
+    const abby::aabb<double> region{{0, 0}, {50, 50}};
+
+    std::vector<int> candidates;
+    CHECK_NOTHROW(tree.query(region, std::back_inserter(candidates)));
+    CHECK(candidates.empty());
+
+    tree.insert(1, {10, 10}, {20, 20});
+    tree.insert(2, {40, 40}, {60, 60});
+    tree.insert(3, {70, 70}, {80, 80});
+
+    tree.query(region, std::back_inserter(candidates));
+    std::sort(candidates.begin(), candidates.end());
+    CHECK(candidates == std::vector<int>{1, 2});
+  }
+
+  TEST_CASE("tree::query_with_aabbs")
+  {
+    abby::tree<int> tree;
+    auto count = 0;
+
+    CHECK_NOTHROW(tree.query_with_aabbs(0, [&](int, const auto&) {
+      ++count;
+    }));
+    CHECK(count == 0);
+
+    tree.insert(1, {10, 10}, {110, 110});
+    tree.insert(2, {90, 10}, {160, 60});
+    tree.insert(3, {10, 90}, {35, 115});
+    tree.insert(4, {200, 200}, {210, 210});
+
+    tree.query_with_aabbs(1, [&](int key, const abby::aabb<double>& aabb) {
+      CHECK(key != 1);
+      CHECK(key != 4);
+      CHECK(aabb == tree.get_aabb(key));
+      ++count;
+    });
+    CHECK(count == 2);
+  }
+
+  TEST_CASE("tree::query_stackless")
+  {
+    abby::tree<int> tree;
+    std::vector<int> candidates;
+
+    CHECK_NOTHROW(tree.query_stackless(0, std::back_inserter(candidates)));
+    CHECK(candidates.empty());
+
+    const auto boxes = make_boxes(100, {15, 15});
+    for (auto i = 0; i < 100; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    for (auto i = 0; i < 100; ++i) {
+      std::vector<int> expected;
+      tree.query(i, std::back_inserter(expected));
+
+      std::vector<int> actual;
+      tree.query_stackless(i, std::back_inserter(actual));
+
+      std::sort(expected.begin(), expected.end());
+      std::sort(actual.begin(), actual.end());
+      CHECK(actual == expected);
+    }
+  }
+
+  TEST_CASE("tree::query_range")
+  {
+    abby::tree<int> tree;
+
+    {
+      const auto range = tree.query_range(0);
+      CHECK(range.begin() == range.end());
+    }
+
+    const auto boxes = make_boxes(100, {15, 15});
+    for (auto i = 0; i < 100; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    for (auto i = 0; i < 100; ++i) {
+      std::vector<int> expected;
+      tree.query(i, std::back_inserter(expected));
+
+      const auto range = tree.query_range(i);
+      std::vector<int> actual{range.begin(), range.end()};
+
+      std::sort(expected.begin(), expected.end());
+      std::sort(actual.begin(), actual.end());
+      CHECK(actual == expected);
+    }
+
+    SUBCASE("Stopping early")
+    {
+      auto count = 0;
+      for (const auto candidate : tree.query_range(1)) {
+        CHECK(candidate != 1);
+        ++count;
+        break;
+      }
+      CHECK(count == 1);
+    }
+  }
+
+  TEST_CASE("tree::query with category mask")
+  {
+    constexpr abby::category_mask player = 1u << 0u;
+    constexpr abby::category_mask enemy = 1u << 1u;
+    constexpr abby::category_mask sensor = 1u << 2u;
+
+    abby::tree<int> tree;
+    tree.insert(1, {0, 0}, {100, 100}, player);
+
+    for (auto i = 2; i < 40; ++i) {
+      const auto offset = static_cast<double>(i);
+      tree.insert(i, {offset, offset}, {offset + 10, offset + 10}, enemy);
+    }
+
+    tree.insert(40, {50, 50}, {60, 60}, sensor);
+    tree.insert(41, {70, 70}, {80, 80}, sensor | enemy);
+
+    const auto collect = [&](abby::category_mask mask) {
+      std::vector<int> candidates;
+      tree.query(1, std::back_inserter(candidates), mask);
+      std::sort(candidates.begin(), candidates.end());
+      return candidates;
+    };
+
+    CHECK(collect(sensor) == std::vector<int>{40, 41});
+    CHECK(collect(enemy).size() == 39);
+    CHECK(collect(player).empty());
+    CHECK(collect(abby::all_categories).size() == 40);
+
+    std::vector<int> stackless;
+    tree.query_stackless(1, std::back_inserter(stackless), sensor);
+    std::sort(stackless.begin(), stackless.end());
+    CHECK(stackless == std::vector<int>{40, 41});
+
+    const auto range = tree.query_range(1, sensor);
+    std::vector<int> lazy{range.begin(), range.end()};
+    std::sort(lazy.begin(), lazy.end());
+    CHECK(lazy == std::vector<int>{40, 41});
+
+    tree.erase(30);
+    tree.update(41, {150, 150}, {160, 160});
+    CHECK(collect(sensor) == std::vector<int>{40});
+    CHECK(collect(enemy).size() == 37);
+  }
+
+  TEST_CASE("tree::set_categories")
+  {
+    abby::tree<int> tree;
+    CHECK_NOTHROW(tree.set_categories(0, 1u));
+
+    tree.insert(1, {0, 0}, {10, 10}, 1u);
+    tree.insert(2, {5, 5}, {15, 15}, 1u);
+    tree.insert(3, {8, 8}, {12, 12}, 1u);
+
+    std::vector<int> candidates;
+    tree.query(1, std::back_inserter(candidates), 2u);
+    CHECK(candidates.empty());
+
+    tree.set_categories(3, 2u);
+    tree.query(1, std::back_inserter(candidates), 2u);
+    CHECK(candidates == std::vector<int>{3});
+  }
+
+  TEST_CASE("tree::any_overlap")
+  {
+    abby::tree<int> tree;
+    tree.set_thickness_factor(std::nullopt);
+
+    const abby::aabb<double> box{{10, 10}, {20, 20}};
+    CHECK_FALSE(tree.any_overlap(box));
+
+    tree.insert(1, {0, 0}, {5, 5}, 1u);
+    tree.insert(2, {30, 30}, {40, 40}, 1u);
+    CHECK_FALSE(tree.any_overlap(box));
+
+    tree.insert(3, {15, 15}, {25, 25}, 2u);
+    CHECK(tree.any_overlap(box));
+    CHECK(tree.any_overlap(box, std::nullopt, 2u));
+    CHECK_FALSE(tree.any_overlap(box, std::nullopt, 1u));
+    CHECK_FALSE(tree.any_overlap(box, 3));
+
+    tree.insert(4, {12, 12}, {14, 14}, 1u);
+    CHECK(tree.any_overlap(box, 3));
+    CHECK(tree.any_overlap(box, 4));
+    CHECK(tree.any_overlap(box, 3, 1u));
+  }
+
+  TEST_CASE("tree::nearest_distance")
+  {
+    using vec2 = abby::vector2<double>;
+
+    abby::tree<int> tree;
+    tree.set_thickness_factor(std::nullopt);
+
+    CHECK_FALSE(tree.nearest_distance(vec2{0, 0}));
+
+    const auto boxes = make_boxes(100, {4, 4});
+    for (auto i = 0; i < 100; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    const auto bruteForce = [&](const abby::aabb<double>& aabb, int exclude) {
+      auto best = std::numeric_limits<double>::max();
+      for (auto i = 0; i < 100; ++i) {
+        if (i == exclude) {
+          continue;
+        }
+
+        const auto& other = tree.get_aabb(i);
+        const auto dx = std::max({0.0,
+                                  aabb.min().x - other.max().x,
+                                  other.min().x - aabb.max().x});
+        const auto dy = std::max({0.0,
+                                  aabb.min().y - other.max().y,
+                                  other.min().y - aabb.max().y});
+        best = std::min(best, (dx * dx) + (dy * dy));
+      }
+      return best;
+    };
+
+    for (auto i = 0; i < 100; ++i) {
+      const auto& aabb = tree.get_aabb(i);
+      const auto nearest = tree.nearest_distance(aabb, i);
+      REQUIRE(nearest);
+      CHECK(nearest->key != i);
+      CHECK(nearest->distanceSquared == doctest::Approx(bruteForce(aabb, i)));
+    }
+
+    const vec2 point{250, 250};
+    const auto nearest = tree.nearest_distance(point);
+    REQUIRE(nearest);
+    CHECK(nearest->distanceSquared ==
+          doctest::Approx(bruteForce({point, point}, -1)));
+
+    tree.insert(100, {249, 249}, {251, 251});
+    CHECK(tree.nearest_distance(point)->key == 100);
+    CHECK(tree.nearest_distance(point)->distanceSquared == 0);
+    CHECK(tree.nearest_distance(point, 100)->key != 100);
+  }
+
+  TEST_CASE("tree::count and tree::accumulate")
+  {
+    abby::tree<int, double, abby::sum_aggregate<double>> tree;
+    tree.set_thickness_factor(std::nullopt);
+
+    const aabb_t region{{50, 50}, {150, 150}};
+    CHECK(tree.count(region) == 0);
+    CHECK(tree.accumulate(region) == 0);
+
+    const auto boxes = make_boxes(200, {5, 5});
+
+    std::vector<double> values;
+    for (auto i = 0; i < 200; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      values.push_back(i * 0.5);
+      tree.insert(i, box.min(), box.max(), abby::all_categories, values[i]);
+    }
+
+    const auto bruteForce = [&](const aabb_t& box) {
+      std::size_t count{0};
+      double sum{0};
+      for (auto i = 0; i < 200; ++i) {
+        if (tree.contains(i) && tree.get_aabb(i).overlaps(box, true)) {
+          ++count;
+          sum += values[i];
+        }
+      }
+      return std::make_pair(count, sum);
+    };
+
+    {
+      const auto [count, sum] = bruteForce(region);
+      CHECK(count > 0);
+      CHECK(tree.count(region) == count);
+      CHECK(tree.accumulate(region) == doctest::Approx(sum));
+    }
+
+    const aabb_t everything{{-10, -10}, {300, 300}};
+    CHECK(tree.count(everything) == tree.size());
+
+    for (auto i = 3; i < 200; i += 3) {
+      tree.erase(i);
+    }
+    tree.update(1, {60, 60}, {70, 70});
+    tree.set_value(2, 1000);
+    values[2] = 1000;
+
+    {
+      const auto [count, sum] = bruteForce(region);
+      CHECK(tree.count(region) == count);
+      CHECK(tree.accumulate(region) == doctest::Approx(sum));
+    }
+
+    tree.rebuild();
+    CHECK(tree.count(everything) == tree.size());
+    CHECK(tree.accumulate(everything) ==
+          doctest::Approx(bruteForce(everything).second));
+  }
+
+  TEST_CASE("tree::rebuild with binned SAH")
+  {
+    abby::tree<int> tree;
+    CHECK_NOTHROW(tree.rebuild(abby::rebuild_strategy::binned_sah));
+    CHECK(tree.is_empty());
+
+    const auto boxes = make_boxes(200);
+    for (auto i = 0; i < 200; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    // Entries with identical centroids must still be split
+    for (auto i = 200; i < 210; ++i) {
+      tree.insert(i, {50, 50}, {52, 52});
+    }
+
+    const auto collect = [&](const int key) {
+      std::vector<int> result;
+      tree.query(key, std::back_inserter(result));
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+
+    std::vector<std::vector<int>> before;
+    for (auto i = 0; i < 210; ++i) {
+      before.push_back(collect(i));
+    }
+
+    const auto ratio = tree.compute_surface_area_ratio();
+    tree.rebuild(abby::rebuild_strategy::binned_sah);
+
+    CHECK(tree.size() == 210);
+    CHECK(tree.compute_surface_area_ratio() <= ratio);
+
+    for (auto i = 0; i < 210; ++i) {
+      CHECK(collect(i) == before.at(static_cast<std::size_t>(i)));
+    }
+
+    tree.erase(3);
+    tree.update(4, {0, 0}, {1, 1});
+    tree.insert(300, {10, 10}, {20, 20});
+    CHECK(tree.size() == 210);
+  }
+
+  TEST_CASE("tree::rebuild with PLOC")
+  {
+    abby::tree<int> tree;
+    CHECK_NOTHROW(tree.rebuild(abby::rebuild_strategy::ploc));
+
+    for (auto i = 0; i < 10'000; ++i) {
+      const auto x = static_cast<double>((i * 7919) % 1009);
+      const auto y = static_cast<double>((i * 104729) % 1013);
+      tree.insert(i, {x, y}, {x + 1 + (i % 3), y + 1});
+    }
+
+    const auto collect = [&](const int key) {
+      std::vector<int> result;
+      tree.query(key, std::back_inserter(result));
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+
+    std::vector<std::vector<int>> before;
+    for (auto i = 0; i < 10'000; i += 97) {
+      before.push_back(collect(i));
+    }
+
+    const auto ratio = tree.compute_surface_area_ratio();
+    tree.rebuild(abby::rebuild_strategy::ploc);
+    CHECK(tree.size() == 10'000);
+    CHECK(tree.compute_surface_area_ratio() < ratio);
+
+    for (auto i = 0; i < 10'000; i += 97) {
+      CHECK(collect(i) == before.at(static_cast<std::size_t>(i / 97)));
+    }
+
+    std::ostringstream expected;
+    tree.print(expected);
+
+    tree.rebuild(abby::rebuild_strategy::ploc, 4);
+
+    std::ostringstream actual;
+    tree.print(actual);
+    CHECK(actual.str() == expected.str());
+  }
+
+  TEST_CASE("tree::build")
+  {
+    abby::tree<int> tree{4};
+    tree.set_thickness_factor(std::nullopt);
+
+    std::vector<std::pair<int, aabb_t>> entries;
+    CHECK_NOTHROW(tree.build(entries.begin(), entries.end()));
+    CHECK(tree.is_empty());
+
+    entries.emplace_back(7, aabb_t{{1, 1}, {2, 2}});
+    tree.build(entries.begin(), entries.end());
+    CHECK(tree.size() == 1);
+    CHECK(tree.contains(7));
+
+    entries.clear();
+    const auto boxes = make_boxes(300);
+    for (auto i = 0; i < 300; ++i) {
+      entries.emplace_back(i, boxes.at(static_cast<std::size_t>(i)));
+    }
+
+    // Entries with identical Morton codes
+    for (auto i = 300; i < 320; ++i) {
+      entries.emplace_back(i, aabb_t{{50, 50}, {52, 52}});
+    }
+
+    tree.insert(1000, {0, 0}, {1, 1});
+    tree.build(entries.begin(), entries.end());
+    CHECK(tree.size() == entries.size());
+    CHECK(!tree.contains(1000));
+
+    const auto bruteForce = [&](const aabb_t& region) {
+      std::vector<int> result;
+      for (const auto& [key, aabb] : entries) {
+        if (region.overlaps(aabb, true)) {
+          result.push_back(key);
+        }
+      }
+      return result;
+    };
+
+    const auto query = [&](const aabb_t& region) {
+      std::vector<int> result;
+      tree.query(region, std::back_inserter(result));
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+
+    for (const auto& region : {aabb_t{{0, 0}, {20, 20}},
+                               aabb_t{{45, 45}, {55, 55}},
+                               aabb_t{{-10, -10}, {300, 300}}}) {
+      CHECK(query(region) == bruteForce(region));
+    }
+
+    tree.erase(3);
+    tree.update(4, {0, 0}, {1, 1});
+    tree.insert(1000, {10, 10}, {20, 20});
+    CHECK(tree.size() == entries.size());
+
+    const aabb_t everything{{-10, -10}, {300, 300}};
+    const auto before = query(everything);
+
+    tree.rebuild(abby::rebuild_strategy::lbvh);
+    CHECK(tree.size() == entries.size());
+    CHECK(query(everything) == before);
+  }
+
+  TEST_CASE("tree::build with several threads")
+  {
+    std::vector<std::pair<int, aabb_t>> entries;
+    for (auto i = 0; i < 20'000; ++i) {
+      const auto x = static_cast<double>((i * 7919) % 1009);
+      const auto y = static_cast<double>((i * 104729) % 1013);
+      entries.emplace_back(i, aabb_t{{x, y}, {x + 1 + (i % 3), y + 1}});
+    }
+
+    const auto print = [&](const std::size_t threadCount) {
+      abby::tree<int> tree;
+      tree.build(entries.begin(), entries.end(), threadCount);
+      REQUIRE(tree.size() == entries.size());
+
+      std::ostringstream stream;
+      tree.print(stream);
+      return stream.str();
+    };
+
+    const auto expected = print(1);
+    CHECK(print(2) == expected);
+    CHECK(print(3) == expected);
+    CHECK(print(8) == expected);
+  }
+
+  TEST_CASE("tree::insert_range")
+  {
+    using vector_t = abby::vector2<double>;
+    using entry_t = std::tuple<int, vector_t, vector_t>;
+
+    abby::tree<int> tree;
+    tree.set_thickness_factor(std::nullopt);
+
+    std::vector<entry_t> entries;
+    CHECK_NOTHROW(tree.insert_range(entries.begin(), entries.end()));
+    CHECK(tree.is_empty());
+
+    const auto boxes = make_boxes(130);
+    const auto makeEntries = [&](const int begin, const int end) {
+      std::vector<entry_t> result;
+      for (auto i = begin; i < end; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        result.emplace_back(i, box.min(), box.max());
+      }
+      return result;
+    };
+
+    // The first batch is larger than the tree, so the tree is rebuilt
+    const auto first = makeEntries(0, 100);
+    tree.insert_range(first.begin(), first.end());
+    CHECK(tree.size() == 100);
+
+    // The second batch is spliced into the existing tree
+    const auto second = makeEntries(100, 130);
+    tree.insert_range(second.begin(), second.end());
+    CHECK(tree.size() == 130);
+
+    const auto query = [&](const aabb_t& region) {
+      std::vector<int> result;
+      tree.query(region, std::back_inserter(result));
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+
+    const auto bruteForce = [&](const aabb_t& region) {
+      std::vector<int> result;
+      for (auto i = 0; i < 130; ++i) {
+        if (region.overlaps(boxes.at(static_cast<std::size_t>(i)), true)) {
+          result.push_back(i);
+        }
+      }
+      return result;
+    };
+
+    for (const auto& region : {aabb_t{{0, 0}, {20, 20}},
+                               aabb_t{{45, 45}, {55, 55}},
+                               aabb_t{{-10, -10}, {300, 300}}}) {
+      CHECK(query(region) == bruteForce(region));
+    }
+
+    for (auto i = 0; i < 130; i += 2) {
+      tree.erase(i);
+    }
+    CHECK(tree.size() == 65);
+  }
+
+  TEST_CASE("tree::query_all_pairs")
+  {
+    SUBCASE("Empty tree")
+    {
+      abby::tree<int> tree;
+      auto count = 0;
+
+      CHECK_NOTHROW(tree.query_all_pairs([&](int, int) {
+        ++count;
+      }));
+      CHECK(count == 0);
+    }
+
+    SUBCASE("Populated tree")
+    {
+      abby::tree<int> tree;
+      tree.set_thickness_factor(std::nullopt);
+
+      const auto boxes = make_boxes(100, {15, 15});
+      for (auto i = 0; i < 100; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        tree.insert(i, box.min(), box.max());
+      }
+
+      std::set<std::pair<int, int>> expected;
+      for (auto i = 0; i < 100; ++i) {
+        std::vector<int> candidates;
+        tree.query(i, std::back_inserter(candidates));
+        for (const auto candidate : candidates) {
+          expected.emplace(std::min(i, candidate), std::max(i, candidate));
+        }
+      }
+
+      std::set<std::pair<int, int>> actual;
+      auto count = 0;
+      tree.query_all_pairs([&](int fst, int snd) {
+        CHECK(fst != snd);
+        actual.emplace(std::min(fst, snd), std::max(fst, snd));
+        ++count;
+      });
+
+      CHECK(!actual.empty());
+      CHECK(count == actual.size());  // Each pair is only reported once
+      CHECK(actual == expected);
+    }
+  }
+
+  TEST_CASE("tree::query_pairs")
+  {
+    abby::tree<int> dynamic;
+    abby::tree<std::string> world;
+    dynamic.set_thickness_factor(std::nullopt);
+    world.set_thickness_factor(std::nullopt);
+
+    SUBCASE("Empty trees")
+    {
+      auto count = 0;
+      dynamic.query_pairs(world, [&](int, const std::string&) {
+        ++count;
+      });
+      CHECK(count == 0);
+    }
+
+    SUBCASE("Populated trees")
+    {
+      const auto boxes = make_boxes(50, {10, 10});
+      for (auto i = 0; i < 50; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        dynamic.insert(i, box.min(), box.max());
+
+        const auto wx = static_cast<double>((i * 53) % 200);
+        const auto wy = static_cast<double>((i * 29) % 200);
+        world.insert(std::to_string(i), {wx, wy}, {wx + 20, wy + 5});
+      }
+
+      std::set<std::pair<int, std::string>> expected;
+      for (auto i = 0; i < 50; ++i) {
+        for (auto j = 0; j < 50; ++j) {
+          const auto& fst = dynamic.get_aabb(i);
+          const auto& snd = world.get_aabb(std::to_string(j));
+          if (fst.overlaps(snd, true)) {
+            expected.emplace(i, std::to_string(j));
+          }
+        }
+      }
+
+      std::set<std::pair<int, std::string>> actual;
+      auto count = 0;
+      dynamic.query_pairs(world, [&](int key, const std::string& other) {
+        actual.emplace(key, other);
+        ++count;
+      });
+
+      CHECK(!actual.empty());
+      CHECK(count == actual.size());
+      CHECK(actual == expected);
+    }
+  }
+
+  TEST_CASE("tree::refit")
+  {
+    abby::tree<int> tree;
+
+    std::vector<std::pair<int, aabb_t>> entries;
+    CHECK(tree.refit(entries.begin(), entries.end()) == 0);
+
+    const auto boxes = make_boxes(200);
+    for (auto i = 0; i < 200; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+      entries.emplace_back(i, box);
+    }
+
+    std::ostringstream before;
+    tree.print(before);
+    const auto nodeCount = tree.node_count();
+
+    // Move every other entry, and include an unknown key
+    for (auto i = 0; i < 200; i += 2) {
+      auto& [key, aabb] = entries.at(static_cast<std::size_t>(i));
+      const abby::vector2<double> offset{(i % 5) - 2.0, (i % 3) + 1.0};
+      aabb = aabb_t{aabb.min() + offset, aabb.max() + offset};
+    }
+    entries.emplace_back(1000, aabb_t{{0, 0}, {1, 1}});
+
+    const auto ratio = tree.refit(entries.begin(), entries.end());
+    CHECK(ratio == tree.compute_surface_area_ratio());
+    CHECK(!tree.contains(1000));
+    entries.pop_back();
+
+    // The structure is unchanged
+    std::ostringstream after;
+    tree.print(after);
+    CHECK(after.str() == before.str());
+    CHECK(tree.node_count() == nodeCount);
+
+    for (const auto& [key, aabb] : entries) {
+      CHECK(tree.get_aabb(key).contains(aabb));
+
+      std::vector<int> candidates;
+      tree.query(aabb, std::back_inserter(candidates));
+      CHECK(std::find(candidates.begin(), candidates.end(), key) !=
+            candidates.end());
+    }
+  }
+
+  TEST_CASE("tree::update_batch")
+  {
+    const auto run = [](const abby::balancing_strategy strategy) {
+      abby::tree<int> tree;
+      tree.set_balancing_strategy(strategy);
+
+      std::vector<int> keys;
+      std::vector<aabb_t> boxes;
+      CHECK(tree.update_batch(keys.begin(), keys.end(), boxes.begin()) == 0);
+
+      boxes = make_boxes(300);
+      for (auto i = 0; i < 300; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        tree.insert(i, box.min(), box.max());
+        keys.push_back(i);
+      }
+
+      const auto nodeCount = tree.node_count();
+
+      // Unchanged AABBs are within the fattened AABBs
+      CHECK(tree.update_batch(keys.begin(), keys.end(), boxes.begin()) == 0);
+
+      // Move every third entry far away and nudge the others
+      for (std::size_t i = 0; i < boxes.size(); ++i) {
+        auto& box = boxes.at(i);
+        const auto offset = (i % 3 == 0) ? abby::vector2{40.0, -30.0}
+                                         : abby::vector2{0.01, 0.01};
+        box = aabb_t{box.min() + offset, box.max() + offset};
+      }
+
+      // Include an unknown key and a repeated key, which is moved twice
+      keys.push_back(1000);
+      boxes.emplace_back(abby::vector2{0.0, 0.0}, abby::vector2{1.0, 1.0});
+      keys.push_back(0);
+      boxes.emplace_back(abby::vector2{-50.0, -50.0},
+                         abby::vector2{-48.0, -48.0});
+
+      CHECK(tree.update_batch(keys.begin(), keys.end(), boxes.begin()) ==
+            101);
+      CHECK(!tree.contains(1000));
+      CHECK(tree.node_count() == nodeCount);
+      CHECK(tree.get_aabb(0).contains(boxes.back()));
+
+      keys.resize(300);
+      boxes.resize(300);
+      boxes.front() = aabb_t{{-50, -50}, {-48, -48}};
+
+      expect_superset(tree, boxes, {{30, -20}, {90, 40}});
+    };
+
+    run(abby::balancing_strategy::height);
+    run(abby::balancing_strategy::surface_area);
+    run(abby::balancing_strategy::none);
+  }
+
+  TEST_CASE("tree::optimize")
+  {
+    abby::tree<int> tree;
+    CHECK(tree.optimize(10) == 0);
+
+    tree.insert(1, {0, 0}, {1, 1});
+    CHECK(tree.optimize(10) == 0);
+
+    const auto boxes = make_boxes(400);
+
+    tree.clear();
+    for (auto i = 0; i < 400; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    // Scramble the tree by moving every entry to the position of another one
+    std::vector<aabb_t> moved;
+    for (auto i = 0; i < 400; ++i) {
+      moved.push_back(boxes.at(static_cast<std::size_t>((i * 7) % 400)));
+      tree.update(i, moved.back());
+    }
+
+    const auto ratio = tree.compute_surface_area_ratio();
+    const auto nodeCount = tree.node_count();
+
+    CHECK(tree.optimize(20) <= 20);
+    for (auto i = 0; i < 10; ++i) {
+      tree.optimize(50);
+    }
+
+    // Small budgets only rank a window, but repeated calls cover every node
+    auto reinsertedCount = 0u;
+    for (auto i = 0; i < 200; ++i) {
+      reinsertedCount += tree.optimize(1);
+    }
+    CHECK(reinsertedCount > 0);
+
+    CHECK(tree.size() == 400);
+    CHECK(tree.node_count() == nodeCount);
+    CHECK(tree.compute_surface_area_ratio() < ratio);
+
+    expect_superset(tree, moved, {{50, 50}, {120, 90}});
+  }
+
+  TEST_CASE("tree::optimize_treelets")
+  {
+    abby::tree<int> tree;
+    CHECK(tree.optimize_treelets() == 0);
+
+    tree.insert(1, {0, 0}, {1, 1});
+    tree.insert(2, {5, 0}, {6, 1});
+    CHECK(tree.optimize_treelets() == 0);
+
+    const auto boxes = make_boxes(400);
+
+    std::vector<std::pair<int, aabb_t>> entries;
+    for (auto i = 0; i < 400; ++i) {
+      entries.emplace_back(i, boxes.at(static_cast<std::size_t>(i)));
+    }
+
+    // The linear BVH only depends on the centres, which leaves room for
+    // improvement
+    tree.build(entries.begin(), entries.end());
+
+    const auto ratio = tree.compute_surface_area_ratio();
+    const auto nodeCount = tree.node_count();
+
+    CHECK(tree.optimize_treelets() != 0);
+
+    const auto onePassRatio = tree.compute_surface_area_ratio();
+    CHECK(onePassRatio < ratio);
+
+    tree.optimize_treelets(4, 4);
+    CHECK(tree.compute_surface_area_ratio() <= onePassRatio);
+
+    CHECK(tree.size() == 400);
+    CHECK(tree.node_count() == nodeCount);
+
+    expect_superset(tree, boxes, {{50, 50}, {120, 90}});
+  }
+
+  TEST_CASE("tree::set_insertion_strategy")
+  {
+    CHECK(abby::tree<int>{}.get_insertion_strategy() ==
+          abby::insertion_strategy::greedy);
+
+    const auto boxes = make_boxes(500);
+
+    const auto run = [&](const abby::insertion_strategy strategy) {
+      abby::tree<int> tree;
+      tree.set_insertion_strategy(strategy);
+      CHECK(tree.get_insertion_strategy() == strategy);
+
+      for (auto i = 0; i < 500; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        tree.insert(i, box.min(), box.max());
+      }
+
+      for (auto i = 0; i < 500; i += 5) {
+        tree.erase(i);
+      }
+
+      expect_superset(tree, boxes, {{50, 50}, {120, 90}});
+
+      return tree.compute_surface_area_ratio();
+    };
+
+    const auto greedyRatio = run(abby::insertion_strategy::greedy);
+    const auto optimalRatio = run(abby::insertion_strategy::branch_and_bound);
+    CHECK(optimalRatio < greedyRatio);
+  }
+
+  TEST_CASE("tree::set_rebuild_policy")
+  {
+    abby::tree<int> tree;
+    CHECK(!tree.get_rebuild_policy());
+
+    const auto fill = [&] {
+      const auto boxes = make_boxes(300);
+      for (auto i = 0; i < 300; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        tree.insert(i, box.min(), box.max());
+      }
+    };
+
+    // Returns the amount of entries that were reinserted
+    const auto scramble = [&](const int factor) {
+      std::size_t count{0};
+      for (auto i = 0; i < 300; ++i) {
+        const auto x = static_cast<double>((i * factor) % 211);
+        const auto y = static_cast<double>((i * 13) % 199);
+        if (tree.update(i, {x, y}, {x + 3, y + 2})) {
+          ++count;
+        }
+      }
+      return count;
+    };
+
+    fill();
+    tree.rebuild(abby::rebuild_strategy::binned_sah);
+
+    abby::rebuild_policy policy;
+    policy.threshold = 1.1;
+    policy.minSize = 16;
+    tree.set_rebuild_policy(policy);
+
+    REQUIRE(tree.get_rebuild_policy());
+    CHECK(tree.get_rebuild_stats().baselineRatio ==
+          tree.compute_surface_area_ratio());
+
+    CHECK(!tree.is_maintenance_pending());
+    CHECK(!tree.maintain());
+
+    // The quality degrades halfway through and then recovers
+    auto updateCount = scramble(101);
+    CHECK(tree.is_maintenance_pending());
+    CHECK(!tree.maintain());
+    CHECK(!tree.is_maintenance_pending());
+
+    // The mutations only schedule the maintenance
+    updateCount += scramble(59);
+
+    const auto& stats = tree.get_rebuild_stats();
+    CHECK(stats.checks == updateCount);
+    CHECK(stats.rebuilds == 0);
+    CHECK(tree.is_maintenance_pending());
+
+    CHECK(tree.maintain());
+    CHECK(!tree.is_maintenance_pending());
+    CHECK(stats.rebuilds == 1);
+    CHECK(stats.optimizations == 0);
+    CHECK(tree.compute_surface_area_ratio() <=
+          policy.threshold * stats.baselineRatio);
+    CHECK(!tree.maintain());
+
+    policy.threshold = 1.05;
+    policy.optimizeBudget = 8;
+    tree.set_rebuild_policy(policy);
+    CHECK(tree.get_rebuild_stats().checks == 0);
+
+    scramble(101);
+    scramble(37);
+    REQUIRE(tree.is_maintenance_pending());
+    CHECK(tree.maintain());
+    CHECK(tree.get_rebuild_stats().optimizations == 1);
+    CHECK(tree.compute_surface_area_ratio() <=
+          policy.threshold * tree.get_rebuild_stats().baselineRatio);
+
+    tree.set_rebuild_policy(std::nullopt);
+    scramble(59);
+    CHECK(tree.get_rebuild_stats().checks == 0);
+    CHECK(!tree.is_maintenance_pending());
+    CHECK(!tree.maintain());
+
+    // Small trees are not maintained
+    tree.clear();
+    tree.set_rebuild_policy(policy);
+    tree.insert(1, {0, 0}, {1, 1});
+    tree.erase(1);
+    CHECK(tree.get_rebuild_stats().checks == 0);
+  }
+
+  TEST_CASE("tree::set_balancing_strategy")
+  {
+    const auto run = [](const abby::balancing_strategy strategy) {
+      abby::tree<int> tree;
+      tree.set_balancing_strategy(strategy);
+      CHECK(tree.get_balancing_strategy() == strategy);
+
+      auto boxes = make_boxes(500);
+      for (auto i = 0; i < 500; ++i) {
+        const auto& box = boxes.at(static_cast<std::size_t>(i));
+        tree.insert(i, box.min(), box.max());
+      }
+
+      for (auto frame = 0; frame < 10; ++frame) {
+        for (auto i = 0; i < 500; i += 3) {
+          const abby::vector2<double> offset{(i % 5) - 2.0, (i % 7) - 3.0};
+          auto& box = boxes.at(static_cast<std::size_t>(i));
+          box = {box.min() + offset, box.max() + offset};
+          tree.update(i, box);
+        }
+      }
+
+      expect_superset(tree, boxes, {{50, 50}, {120, 90}});
+
+      return tree.compute_surface_area_ratio();
+    };
+
+    abby::tree<int> tree;
+    CHECK(tree.get_balancing_strategy() == abby::balancing_strategy::height);
+
+    const auto heightRatio = run(abby::balancing_strategy::height);
+    const auto areaRatio = run(abby::balancing_strategy::surface_area);
+    CHECK(areaRatio < heightRatio);
+
+    run(abby::balancing_strategy::none);
+
+    // Without rotations, an insertion followed by a removal restores the tree
+    tree.set_balancing_strategy(abby::balancing_strategy::none);
+    const auto boxes = make_boxes(100);
+    for (auto i = 0; i < 100; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+
+    tree.rebuild(abby::rebuild_strategy::binned_sah);
+    const auto height = tree.height();
+    const auto ratio = tree.compute_surface_area_ratio();
+
+    tree.insert(100, {10, 10}, {20, 20});
+    tree.erase(100);
+
+    CHECK(tree.height() == height);
+    CHECK(tree.compute_surface_area_ratio() == doctest::Approx(ratio));
+  }
+
+  TEST_CASE("tree::cost_metric")
+  {
+    const aabb_t corridor{{0, 0}, {10, 2}};
+    CHECK(abby::perimeter_metric::cost(corridor) == 24);
+    CHECK(abby::area_metric::cost(corridor) == 20);
+
+    // Long horizontal and vertical corridors that cross each other
+    std::vector<aabb_t> boxes;
+    for (auto i = 0; i < 300; ++i) {
+      const auto offset = static_cast<double>((i * 37) % 101);
+      const auto lane = static_cast<double>((i * 53) % 197);
+      if (i % 2 == 0) {
+        boxes.emplace_back(abby::vector2{offset, lane},
+                           abby::vector2{offset + 80, lane + 1});
+      } else {
+        boxes.emplace_back(abby::vector2{lane, offset},
+                           abby::vector2{lane + 1, offset + 80});
+      }
+    }
+
+    const aabb_t region{{40, 40}, {60, 45}};
+
+    std::vector<int> expected;
+    for (auto i = 0; i < 300; ++i) {
+      if (region.overlaps(boxes.at(static_cast<std::size_t>(i)), true)) {
+        expected.push_back(i);
+      }
+    }
+
+    const auto check = [&](const auto& tree) {
+      std::vector<int> candidates;
+      tree.query(region, std::back_inserter(candidates));
+      std::sort(candidates.begin(), candidates.end());
+      CHECK(candidates == expected);
+    };
+
+    abby::tree<int, double, abby::no_aggregate, abby::area_metric> tree;
+    tree.set_thickness_factor(std::nullopt);
+    tree.set_insertion_strategy(abby::insertion_strategy::branch_and_bound);
+
+    for (auto i = 0; i < 300; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      tree.insert(i, box.min(), box.max());
+    }
+    check(tree);
+
+    tree.optimize(100);
+    check(tree);
+
+    tree.rebuild(abby::rebuild_strategy::binned_sah);
+    check(tree);
+
+    tree.rebuild(abby::rebuild_strategy::ploc);
+    check(tree);
+
+    // User-defined metrics only need a static cost function
+    struct width_metric final
+    {
+      static auto cost(const aabb_t& aabb) -> double
+      {
+        return aabb.size().x;
+      }
+    };
+
+    abby::tree<int, double, abby::no_aggregate, width_metric> other;
+    other.set_thickness_factor(std::nullopt);
+    for (auto i = 0; i < 300; ++i) {
+      const auto& box = boxes.at(static_cast<std::size_t>(i));
+      other.insert(i, box.min(), box.max());
+    }
+    check(other);
+
+    auto pairs = 0;
+    tree.query_pairs(other, [&](int, int) { ++pairs; });
+    CHECK(pairs != 0);
+  }
+
   TEST_CASE("tree::get_aabb")
   {
     abby::tree<int> tree;